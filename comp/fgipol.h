@@ -0,0 +1,437 @@
+#ifndef _FGIPOL_H
+#define _FGIPOL_H
+
+#include "rtapi.h"
+#include "rtapi_math.h"
+#include "rtapi_string.h"
+#include "hal.h"
+
+// interpolation filters shared by fgipol and fgipoln, all axes of an
+// instance share the frame timing, the per axis state is kept in
+// structure of arrays form
+
+#define FGIPOL_MAX_AXES 16
+
+#define FGIPOL_MODE_PGAIN   0
+#define FGIPOL_MODE_HERMITE 1
+#define FGIPOL_MODE_KALMAN  2
+#define FGIPOL_MODE_JITBUF  3
+
+#define FGIPOL_JB_SIZE 16
+#define FGIPOL_JB_MASK (FGIPOL_JB_SIZE - 1)
+// lower limit of the recovered frame interval in s
+#define FGIPOL_JB_MIN_INTERVAL 1e-4
+
+#define FGIPOL_KF_ACCEL_VAR 1e6
+#define FGIPOL_LATENCY_FILTER 0.1
+
+// the comps fill this in declaration order, the field names would
+// clash with their param macros
+typedef struct {
+  unsigned mode;
+  unsigned stall_time_ms;
+  int use_new_frame;
+  double pgain;
+  double kf_q;
+  double kf_r_pos;
+  double kf_r_velo;
+  double jb_delay_ms;
+  double jb_clock_gain;
+  double latency_min_velo;
+} FGIPOL_PARAM_T;
+
+typedef struct {
+  int axes;
+  int stalled;
+  uint32_t underruns;
+
+  long long stall_count;
+  unsigned old_mode;
+  int mode_init;
+  double frame_timer;
+  double frame_interval;
+
+  double seg_time;
+  double seg_len;
+
+  double kf_p00;
+  double kf_p01;
+  double kf_p02;
+  double kf_p11;
+  double kf_p12;
+  double kf_p22;
+
+  double jb_clock;
+  double jb_first_t;
+  double jb_last_t;
+  double jb_interval;
+  int jb_frames;
+  int jb_head;
+  int jb_count;
+  int jb_underrun;
+  double jb_t[FGIPOL_JB_SIZE];
+
+  // per axis output state, last input and latency estimate
+  double *p;
+  double *v;
+  double *a;
+  double *old_in;
+  double *lat;
+  // Hermite segment coefficients
+  double *c0;
+  double *c1;
+  double *c2;
+  double *c3;
+  // jitter buffer samples, all axes of a stamp are adjacent
+  double *jb_p;
+  double *jb_v;
+} FGIPOL_T;
+
+// allocate the filter state of an instance from HAL memory
+static FGIPOL_T *fgipol_alloc(int axes) {
+  FGIPOL_T *ip;
+  double *d;
+
+  ip = hal_malloc(sizeof(FGIPOL_T) + (9 + 2 * FGIPOL_JB_SIZE) * axes * sizeof(double));
+  if (ip == NULL) {
+    return NULL;
+  }
+  memset(ip, 0, sizeof(FGIPOL_T) + (9 + 2 * FGIPOL_JB_SIZE) * axes * sizeof(double));
+
+  ip->axes = axes;
+  d = (double *) (ip + 1);
+  ip->p = d; d += axes;
+  ip->v = d; d += axes;
+  ip->a = d; d += axes;
+  ip->old_in = d; d += axes;
+  ip->lat = d; d += axes;
+  ip->c0 = d; d += axes;
+  ip->c1 = d; d += axes;
+  ip->c2 = d; d += axes;
+  ip->c3 = d; d += axes;
+  ip->jb_p = d; d += FGIPOL_JB_SIZE * axes;
+  ip->jb_v = d;
+
+  return ip;
+}
+
+static void fgipol_update(FGIPOL_T *ip, const FGIPOL_PARAM_T *par, const double *in_p, const double *in_v, int new_frame, uint32_t frame_period_ns, uint32_t age_ns, long period) {
+  const double *bp, *bv, *ep, *ev;
+  double *sp, *sv;
+  int axes = ip->axes;
+  int frame, a, i, j, n;
+  double dt, h, t, tn, p1, v1, vn, lenr;
+  double n00, n01, n02, n11, n12, n22;
+  double s00, s01, s11, det, k00, k01, k10, k11, k20, k21, yp, yv;
+  double raw, err, play, len, c2, c3;
+
+  dt = period * 1e-9;
+
+  // check for position stall (by frame strobe or any position change)
+  // and take the frame interval while not stalled, from the measured
+  // frame period if connected, else from the servo thread
+  frame = 0;
+  for (a = 0; a < axes; a++) {
+    frame |= (in_p[a] != ip->old_in[a]);
+    ip->old_in[a] = in_p[a];
+  }
+  if (par->use_new_frame) {
+    frame = new_frame;
+  }
+  ip->frame_timer += dt;
+  if (frame) {
+    if (ip->stall_count <= 0) {
+      ip->frame_interval = 0.0;
+    } else if (frame_period_ns > 0) {
+      ip->frame_interval = frame_period_ns * 1e-9;
+    } else {
+      ip->frame_interval = ip->frame_timer;
+    }
+    ip->frame_timer = 0.0;
+    ip->stall_count = par->stall_time_ms * 1000000LL;
+  }
+
+  // mode switches restart the filters from the current output
+  if (par->mode != ip->old_mode) {
+    ip->mode_init = 0;
+    ip->old_mode = par->mode;
+  }
+
+  if (ip->stall_count > 0) {
+    ip->stalled = 0;
+    ip->stall_count -= period;
+  } else {
+    ip->stalled = 1;
+  }
+
+  if (ip->stalled || par->mode == FGIPOL_MODE_PGAIN) {
+    // first order corrector, pass thru velocity input if no stall
+    h = ip->stalled ? 0.0 : 1.0;
+    for (a = 0; a < axes; a++) {
+      vn = (in_p[a] - ip->p[a]) * par->pgain + in_v[a] * h;
+      ip->a[a] = (vn - ip->v[a]) / dt;
+      ip->v[a] = vn;
+      ip->p[a] += vn * dt;
+    }
+    ip->mode_init = 0;
+
+  } else if (par->mode == FGIPOL_MODE_HERMITE) {
+    // new segment: cubic from current output state to the
+    // rate-predicted input one frame interval ahead
+    if (frame) {
+      ip->seg_time = 0.0;
+      ip->seg_len = ip->frame_interval;
+      if (ip->seg_len > 0.0) {
+        len = ip->seg_len;
+        lenr = 1.0 / len;
+        for (a = 0; a < axes; a++) {
+          p1 = in_p[a] + in_v[a] * len;
+          v1 = in_v[a];
+          ip->c0[a] = ip->p[a];
+          ip->c1[a] = ip->v[a];
+          ip->c2[a] = (3.0 * (p1 - ip->p[a]) - (2.0 * ip->v[a] + v1) * len) * lenr * lenr;
+          ip->c3[a] = (2.0 * (ip->p[a] - p1) + (ip->v[a] + v1) * len) * lenr * lenr * lenr;
+        }
+      } else {
+        // no interval known yet, continue with the input rate
+        for (a = 0; a < axes; a++) {
+          ip->c0[a] = ip->p[a];
+          ip->c1[a] = in_v[a];
+          ip->c2[a] = 0.0;
+          ip->c3[a] = 0.0;
+        }
+      }
+    }
+
+    // evaluate segments, continue linear past their end
+    ip->seg_time += dt;
+    t = ip->seg_time;
+    if (t > ip->seg_len) {
+      h = t - ip->seg_len;
+      t = ip->seg_len;
+    } else {
+      h = 0.0;
+    }
+    tn = (h > 0.0) ? 0.0 : 1.0;
+    for (a = 0; a < axes; a++) {
+      ip->v[a] = ip->c1[a] + (2.0 * ip->c2[a] + 3.0 * ip->c3[a] * t) * t;
+      ip->p[a] = ip->c0[a] + (ip->c1[a] + (ip->c2[a] + ip->c3[a] * t) * t) * t + ip->v[a] * h;
+      ip->a[a] = (2.0 * ip->c2[a] + 6.0 * ip->c3[a] * t) * tn;
+    }
+
+  } else if (par->mode == FGIPOL_MODE_KALMAN) {
+    // constant acceleration model per axis, state (p, v, a);
+    // the covariance only depends on the shared frame timing,
+    // so one filter gain serves all axes
+    if (!ip->mode_init) {
+      for (a = 0; a < axes; a++) {
+        ip->a[a] = 0.0;
+      }
+      ip->kf_p00 = par->kf_r_pos;
+      ip->kf_p11 = par->kf_r_velo;
+      ip->kf_p22 = FGIPOL_KF_ACCEL_VAR;
+      ip->kf_p01 = ip->kf_p02 = ip->kf_p12 = 0.0;
+      ip->mode_init = 1;
+    }
+
+    // predict: x = F x, P = F P F' + Q (white jerk)
+    h = 0.5 * dt * dt;
+    for (a = 0; a < axes; a++) {
+      ip->p[a] += ip->v[a] * dt + ip->a[a] * h;
+      ip->v[a] += ip->a[a] * dt;
+    }
+
+    n00 = ip->kf_p00 + dt * ip->kf_p01 + h * ip->kf_p02
+        + dt * (ip->kf_p01 + dt * ip->kf_p11 + h * ip->kf_p12)
+        + h * (ip->kf_p02 + dt * ip->kf_p12 + h * ip->kf_p22);
+    n01 = ip->kf_p01 + dt * ip->kf_p02 + dt * (ip->kf_p11 + dt * ip->kf_p12) + h * (ip->kf_p12 + dt * ip->kf_p22);
+    n02 = ip->kf_p02 + dt * ip->kf_p12 + h * ip->kf_p22;
+    n11 = ip->kf_p11 + 2.0 * dt * ip->kf_p12 + dt * dt * ip->kf_p22;
+    n12 = ip->kf_p12 + dt * ip->kf_p22;
+    n22 = ip->kf_p22;
+
+    ip->kf_p00 = n00 + par->kf_q * dt * dt * dt * dt * dt / 20.0;
+    ip->kf_p01 = n01 + par->kf_q * dt * dt * dt * dt / 8.0;
+    ip->kf_p02 = n02 + par->kf_q * dt * dt * dt / 6.0;
+    ip->kf_p11 = n11 + par->kf_q * dt * dt * dt / 3.0;
+    ip->kf_p12 = n12 + par->kf_q * dt * dt / 2.0;
+    ip->kf_p22 = n22 + par->kf_q * dt;
+
+    // update with position and rate of the new frame
+    if (frame) {
+      s00 = ip->kf_p00 + par->kf_r_pos;
+      s01 = ip->kf_p01;
+      s11 = ip->kf_p11 + par->kf_r_velo;
+      det = s00 * s11 - s01 * s01;
+      if (det > 0.0) {
+        k00 = (ip->kf_p00 * s11 - ip->kf_p01 * s01) / det;
+        k01 = (ip->kf_p01 * s00 - ip->kf_p00 * s01) / det;
+        k10 = (ip->kf_p01 * s11 - ip->kf_p11 * s01) / det;
+        k11 = (ip->kf_p11 * s00 - ip->kf_p01 * s01) / det;
+        k20 = (ip->kf_p02 * s11 - ip->kf_p12 * s01) / det;
+        k21 = (ip->kf_p12 * s00 - ip->kf_p02 * s01) / det;
+
+        for (a = 0; a < axes; a++) {
+          yp = in_p[a] - ip->p[a];
+          yv = in_v[a] - ip->v[a];
+          ip->p[a] += k00 * yp + k01 * yv;
+          ip->v[a] += k10 * yp + k11 * yv;
+          ip->a[a] += k20 * yp + k21 * yv;
+        }
+
+        // P = (I - K H) P
+        n00 = ip->kf_p00 - k00 * ip->kf_p00 - k01 * ip->kf_p01;
+        n01 = ip->kf_p01 - k00 * ip->kf_p01 - k01 * ip->kf_p11;
+        n02 = ip->kf_p02 - k00 * ip->kf_p02 - k01 * ip->kf_p12;
+        n11 = ip->kf_p11 - k10 * ip->kf_p01 - k11 * ip->kf_p11;
+        n12 = ip->kf_p12 - k10 * ip->kf_p02 - k11 * ip->kf_p12;
+        n22 = ip->kf_p22 - k20 * ip->kf_p02 - k21 * ip->kf_p12;
+        ip->kf_p00 = n00;
+        ip->kf_p01 = n01;
+        ip->kf_p02 = n02;
+        ip->kf_p11 = n11;
+        ip->kf_p12 = n12;
+        ip->kf_p22 = n22;
+      }
+    }
+
+  } else if (par->mode == FGIPOL_MODE_JITBUF) {
+    if (!ip->mode_init) {
+      ip->jb_count = 0;
+      ip->jb_frames = -1;
+      ip->mode_init = 1;
+    }
+    ip->jb_clock += dt;
+
+    // stamp new samples with their receive time, smoothed by a
+    // clock recovery loop locked to the sender frame rate
+    if (frame) {
+      raw = ip->jb_clock - age_ns * 1e-9;
+      n = 0;
+      if (ip->jb_frames >= FGIPOL_JB_SIZE) {
+        // whole intervals since the last stamp, no usable interval
+        // (e.g. a burst with equal stamps) restarts acquisition
+        tn = (ip->jb_interval > 0.0) ? (raw - ip->jb_last_t) / ip->jb_interval + 0.5 : FGIPOL_JB_SIZE + 1;
+        n = (tn >= FGIPOL_JB_SIZE + 1) ? FGIPOL_JB_SIZE + 1 : ((tn > 0.0) ? (int) tn : 0);
+      }
+      if (ip->jb_frames < 0 || n > FGIPOL_JB_SIZE) {
+        // (re)start acquisition
+        ip->jb_first_t = raw;
+        ip->jb_last_t = raw;
+        ip->jb_frames = 0;
+      } else if (ip->jb_frames < FGIPOL_JB_SIZE) {
+        // acquisition: mean interval over the first frames
+        ip->jb_frames++;
+        ip->jb_interval = (raw - ip->jb_first_t) / ip->jb_frames;
+        ip->jb_last_t = raw;
+      } else {
+        // tracking: advance by whole intervals (lost frames), correct phase and rate
+        if (n < 1) {
+          n = 1;
+        }
+        err = raw - (ip->jb_last_t + n * ip->jb_interval);
+        ip->jb_last_t += n * ip->jb_interval + err * par->jb_clock_gain;
+        ip->jb_interval += err * par->jb_clock_gain * par->jb_clock_gain / n;
+        if (ip->jb_interval < FGIPOL_JB_MIN_INTERVAL) {
+          ip->jb_interval = FGIPOL_JB_MIN_INTERVAL;
+        }
+      }
+
+      // push sample, drop the oldest one on overflow
+      if (ip->jb_count == FGIPOL_JB_SIZE) {
+        ip->jb_head = (ip->jb_head + 1) & FGIPOL_JB_MASK;
+        ip->jb_count--;
+      }
+      j = (ip->jb_head + ip->jb_count) & FGIPOL_JB_MASK;
+      ip->jb_t[j] = ip->jb_last_t;
+      sp = &ip->jb_p[j * axes];
+      sv = &ip->jb_v[j * axes];
+      for (a = 0; a < axes; a++) {
+        sp[a] = in_p[a];
+        sv[a] = in_v[a];
+      }
+      ip->jb_count++;
+    }
+
+    // drop samples that are completely played back
+    play = ip->jb_clock - par->jb_delay_ms * 0.001;
+    while (ip->jb_count > 1 && ip->jb_t[(ip->jb_head + 1) & FGIPOL_JB_MASK] <= play) {
+      ip->jb_head = (ip->jb_head + 1) & FGIPOL_JB_MASK;
+      ip->jb_count--;
+    }
+
+    i = ip->jb_head;
+    j = (i + 1) & FGIPOL_JB_MASK;
+    t = play - ip->jb_t[i];
+    bp = &ip->jb_p[i * axes];
+    bv = &ip->jb_v[i * axes];
+    ep = &ip->jb_p[j * axes];
+    ev = &ip->jb_v[j * axes];
+
+    // count underruns once per event
+    if (ip->jb_count == 1 && t >= 0.0) {
+      if (!ip->jb_underrun) {
+        ip->underruns++;
+      }
+      ip->jb_underrun = 1;
+    } else {
+      ip->jb_underrun = 0;
+    }
+
+    if (ip->jb_count == 0) {
+      for (a = 0; a < axes; a++) {
+        ip->v[a] = 0.0;
+        ip->a[a] = 0.0;
+      }
+    } else if (t < 0.0) {
+      // buffer still filling, hold first sample
+      for (a = 0; a < axes; a++) {
+        ip->p[a] = bp[a];
+        ip->v[a] = 0.0;
+        ip->a[a] = 0.0;
+      }
+    } else if (ip->jb_count == 1) {
+      // underrun, extrapolate last sample
+      for (a = 0; a < axes; a++) {
+        ip->v[a] = bv[a];
+        ip->p[a] = bp[a] + bv[a] * t;
+        ip->a[a] = 0.0;
+      }
+    } else if ((len = ip->jb_t[j] - ip->jb_t[i]) <= 0.0) {
+      // stamps out of order after a clock restart
+      for (a = 0; a < axes; a++) {
+        ip->p[a] = ep[a];
+        ip->v[a] = ev[a];
+        ip->a[a] = 0.0;
+      }
+    } else {
+      // cubic Hermite between the bracketing samples
+      lenr = 1.0 / len;
+      for (a = 0; a < axes; a++) {
+        c2 = (3.0 * (ep[a] - bp[a]) - (2.0 * bv[a] + ev[a]) * len) * lenr * lenr;
+        c3 = (2.0 * (bp[a] - ep[a]) + (bv[a] + ev[a]) * len) * lenr * lenr * lenr;
+        ip->v[a] = bv[a] + (2.0 * c2 + 3.0 * c3 * t) * t;
+        ip->p[a] = bp[a] + (bv[a] + (c2 + c3 * t) * t) * t;
+        ip->a[a] = 2.0 * c2 + 6.0 * c3 * t;
+      }
+    }
+
+  } else {
+    // unknown mode: hold position
+    for (a = 0; a < axes; a++) {
+      ip->v[a] = 0.0;
+      ip->a[a] = 0.0;
+    }
+  }
+
+  // estimate output lag behind the input trajectory on fresh frames
+  if (frame && !ip->stalled) {
+    for (a = 0; a < axes; a++) {
+      if (fabs(in_v[a]) >= par->latency_min_velo) {
+        ip->lat[a] += ((in_p[a] - ip->p[a]) / in_v[a] * 1000.0 - ip->lat[a]) * FGIPOL_LATENCY_FILTER;
+      }
+    }
+  }
+}
+
+#endif
@@ -10,21 +10,306 @@
 
 #define FGFDM_MODULE_NAME "fgfdm"
 #define FGFDM_SHMEM_KEY 0xed3e3f4a
-#define FGFDM_BUFFER_COUNT 2
+
+#define FGFDM_CACHELINE_SIZE 64
+
+// default/maximum number of ring slots (must be a power of two)
+#define FGFDM_RING_DEPTH_DEFAULT 4
+#define FGFDM_RING_DEPTH_MAX 1024
+
+// number of reads after a torn one, each retry starts over with a
+// fresh head and may skip ahead to newer frames
+#define FGFDM_READ_RETRIES 3
 
 #define FGFDM_LISTENER_TIMEOUT 3000
 
+// latency trace ring (must not overlap the per-instance frame ring keys)
+#define FGFDM_TRACE_SHMEM_KEY 0xed3e3f5a
+#define FGFDM_TRACE_DEPTH_DEFAULT 1024
+#define FGFDM_TRACE_DEPTH_MAX 65536
+
+// FlightGear generic protocol layout, the decoded values share the
+// slot payload with FGNetFDM
+#define FGFDM_GENERIC_MAX_FIELDS (sizeof(FGNetFDM) / sizeof(double))
+#define FGFDM_GENERIC_NAME_LEN 24
+#define FGFDM_GENERIC_SEP_LEN 8
+
+#define FGFDM_GENERIC_TYPE_BOOL   0
+#define FGFDM_GENERIC_TYPE_INT    1
+#define FGFDM_GENERIC_TYPE_FLOAT  2
+#define FGFDM_GENERIC_TYPE_DOUBLE 3
+
+// HAL to FlightGear sample ring
+#define FGFDM_SNDR_SHMEM_KEY 0xed3e3f6a
+#define FGFDM_SNDR_DEPTH 16
+#define FGFDM_SNDR_MAX_VALUES 32
+
 typedef struct {
+  // slot sequence counter (odd while the slot is written)
+  volatile uint32_t seq;
+  // frame number stored in this slot
+  volatile uint32_t frame;
+
   int data_valid;
   uint32_t timestamp;
   uint32_t msgno;
-  FGNetFDM data;
-} FGFDM_BUFFER_T;
+  // receive and publish time (CLOCK_MONOTONIC ns)
+  uint64_t rx_time;
+  uint64_t pub_time;
+  union {
+    FGNetFDM data;
+    double generic[FGFDM_GENERIC_MAX_FIELDS];
+  };
+} __attribute__((aligned(FGFDM_CACHELINE_SIZE))) FGFDM_BUFFER_T;
 
 typedef struct {
-  int wr_pos;
-  int rd_pos;
-  FGFDM_BUFFER_T buffer[FGFDM_BUFFER_COUNT];
+  char name[FGFDM_GENERIC_NAME_LEN];
+  uint16_t type;
+  // byte offset in binary datagrams
+  uint16_t offset;
+} FGFDM_GENERIC_FIELD_T;
+
+typedef struct {
+  // number of fields, 0 for FGNetFDM feeds
+  uint32_t count;
+  // checksum of the table, lets readers detect a changed layout
+  uint32_t hash;
+  uint32_t binary;
+  // binary datagram size including the footer
+  uint32_t size;
+  char var_sep[FGFDM_GENERIC_SEP_LEN];
+  char line_sep[FGFDM_GENERIC_SEP_LEN];
+  FGFDM_GENERIC_FIELD_T field[FGFDM_GENERIC_MAX_FIELDS];
+} FGFDM_GENERIC_LAYOUT_T;
+
+typedef struct {
+  // producer side: number of published frames, latest one is (head - 1)
+  volatile uint32_t head __attribute__((aligned(FGFDM_CACHELINE_SIZE)));
+  uint32_t depth;
+
+  // generic protocol layout, written by the listener before the
+  // first frame is published
+  FGFDM_GENERIC_LAYOUT_T layout;
+
+  // consumer side: number of consumed frames
+  volatile uint32_t tail __attribute__((aligned(FGFDM_CACHELINE_SIZE)));
+  // set by readers that consume every frame, the writer then drops
+  // new frames instead of overwriting unread ones
+  volatile uint32_t lossless;
+
+  FGFDM_BUFFER_T buffer[];
 } FGFDM_SHMEM_T;
 
+static inline int fgfdm_shmem_depth_valid(int depth) {
+  return depth >= 2 && depth <= FGFDM_RING_DEPTH_MAX && (depth & (depth - 1)) == 0;
+}
+
+static inline unsigned long fgfdm_shmem_size(int depth) {
+  return sizeof(FGFDM_SHMEM_T) + depth * sizeof(FGFDM_BUFFER_T);
+}
+
+// writer side: get the slot for the next frame and mark it busy
+static inline FGFDM_BUFFER_T *fgfdm_shmem_write_begin(FGFDM_SHMEM_T *shmem, uint32_t mask) {
+  FGFDM_BUFFER_T *buffer = &shmem->buffer[shmem->head & mask];
+
+  buffer->seq++;
+  fgfdm_smp_wmb();
+
+  return buffer;
+}
+
+// writer side: check if publishing would overwrite an unread frame,
+// at most (depth - 1) frames are pending so the reserved slot is free
+static inline int fgfdm_shmem_full(FGFDM_SHMEM_T *shmem) {
+  return shmem->lossless && shmem->head - shmem->tail >= shmem->depth - 1;
+}
+
+// writer side: release the slot and publish it as latest frame
+static inline void fgfdm_shmem_write_commit(FGFDM_SHMEM_T *shmem, FGFDM_BUFFER_T *buffer) {
+  uint32_t head = shmem->head;
+
+  buffer->frame = head;
+  fgfdm_smp_wmb();
+  buffer->seq++;
+  fgfdm_smp_wmb();
+  shmem->head = head + 1;
+}
+
+// writer side: release a slot that was not written without publishing it
+static inline void fgfdm_shmem_write_abort(FGFDM_BUFFER_T *buffer) {
+  fgfdm_smp_wmb();
+  buffer->seq++;
+}
+
+// reader side: get the number of published frames
+static inline uint32_t fgfdm_shmem_head(FGFDM_SHMEM_T *shmem) {
+  uint32_t head = shmem->head;
+  fgfdm_smp_rmb();
+  return head;
+}
+
+// reader side: copy the given frame, returns -1 if it was torn or overwritten
+static inline int fgfdm_shmem_read(FGFDM_SHMEM_T *shmem, uint32_t mask, uint32_t frame, FGFDM_BUFFER_T *dst) {
+  FGFDM_BUFFER_T *buffer = &shmem->buffer[frame & mask];
+  uint32_t seq;
+
+  seq = buffer->seq;
+  fgfdm_smp_rmb();
+  if ((seq & 1) || buffer->frame != frame) {
+    return -1;
+  }
+
+  dst->data_valid = buffer->data_valid;
+  dst->timestamp = buffer->timestamp;
+  dst->msgno = buffer->msgno;
+  dst->rx_time = buffer->rx_time;
+  dst->pub_time = buffer->pub_time;
+  memcpy(&dst->data, &buffer->data, sizeof(FGNetFDM));
+
+  fgfdm_smp_rmb();
+  if (buffer->seq != seq) {
+    return -1;
+  }
+
+  dst->frame = frame;
+  return 0;
+}
+
+// snapshot of the fgfdm.send.value-NN pins
+typedef struct {
+  // slot sequence counter (odd while the slot is written)
+  volatile uint32_t seq;
+  // sample number stored in this slot
+  volatile uint32_t frame;
+
+  // sample time (CLOCK_MONOTONIC ns)
+  uint64_t time;
+  double value[FGFDM_SNDR_MAX_VALUES];
+} __attribute__((aligned(FGFDM_CACHELINE_SIZE))) FGFDM_SNDR_SAMPLE_T;
+
+typedef struct {
+  // producer side (RT): number of written samples, latest one is (head - 1)
+  volatile uint32_t head __attribute__((aligned(FGFDM_CACHELINE_SIZE)));
+  // number of valid values per sample, 0 until fgfdm is loaded
+  volatile uint32_t count;
+
+  FGFDM_SNDR_SAMPLE_T sample[FGFDM_SNDR_DEPTH];
+} FGFDM_SNDR_SHMEM_T;
+
+// writer side: get the slot for the next sample and mark it busy
+static inline FGFDM_SNDR_SAMPLE_T *fgfdm_sndr_write_begin(FGFDM_SNDR_SHMEM_T *shmem) {
+  FGFDM_SNDR_SAMPLE_T *sample = &shmem->sample[shmem->head & (FGFDM_SNDR_DEPTH - 1)];
+
+  sample->seq++;
+  fgfdm_smp_wmb();
+
+  return sample;
+}
+
+// writer side: release the slot and publish it as latest sample
+static inline void fgfdm_sndr_write_commit(FGFDM_SNDR_SHMEM_T *shmem, FGFDM_SNDR_SAMPLE_T *sample) {
+  uint32_t head = shmem->head;
+
+  sample->frame = head;
+  fgfdm_smp_wmb();
+  sample->seq++;
+  fgfdm_smp_wmb();
+  shmem->head = head + 1;
+}
+
+// reader side: copy the latest sample, returns -1 if none is available
+// or it was overwritten while copying
+static inline int fgfdm_sndr_read_latest(FGFDM_SNDR_SHMEM_T *shmem, FGFDM_SNDR_SAMPLE_T *dst) {
+  FGFDM_SNDR_SAMPLE_T *sample;
+  uint32_t head, seq;
+
+  head = shmem->head;
+  fgfdm_smp_rmb();
+  if (head == 0) {
+    return -1;
+  }
+
+  sample = &shmem->sample[(head - 1) & (FGFDM_SNDR_DEPTH - 1)];
+  seq = sample->seq;
+  fgfdm_smp_rmb();
+  if ((seq & 1) || sample->frame != head - 1) {
+    return -1;
+  }
+
+  dst->time = sample->time;
+  memcpy(dst->value, sample->value, sizeof(dst->value));
+
+  fgfdm_smp_rmb();
+  if (sample->seq != seq) {
+    return -1;
+  }
+
+  dst->frame = head - 1;
+  return 0;
+}
+
+// one traced frame, all times are CLOCK_MONOTONIC ns
+typedef struct {
+  uint32_t instance;
+  uint32_t msgno;
+  uint32_t frame;
+  uint32_t data_valid;
+  // kernel receive, shmem publish, fgfdm.read and fgfdm.trace time
+  uint64_t rx_time;
+  uint64_t pub_time;
+  uint64_t read_time;
+  uint64_t out_time;
+} FGFDM_TRACE_REC_T;
+
+typedef struct {
+  // producer side (RT): number of written records
+  volatile uint32_t head __attribute__((aligned(FGFDM_CACHELINE_SIZE)));
+  uint32_t depth;
+  // records lost because the ring was full
+  volatile uint32_t dropped;
+
+  // consumer side (drain tool): number of read records
+  volatile uint32_t tail __attribute__((aligned(FGFDM_CACHELINE_SIZE)));
+
+  FGFDM_TRACE_REC_T rec[];
+} FGFDM_TRACE_T;
+
+static inline int fgfdm_trace_depth_valid(int depth) {
+  return depth >= 2 && depth <= FGFDM_TRACE_DEPTH_MAX && (depth & (depth - 1)) == 0;
+}
+
+static inline unsigned long fgfdm_trace_size(int depth) {
+  return sizeof(FGFDM_TRACE_T) + depth * sizeof(FGFDM_TRACE_REC_T);
+}
+
+// writer side: append a record, never blocks but drops it if the ring is full
+static inline void fgfdm_trace_put(FGFDM_TRACE_T *trace, const FGFDM_TRACE_REC_T *rec) {
+  uint32_t head = trace->head;
+
+  if (head - trace->tail >= trace->depth) {
+    trace->dropped++;
+    return;
+  }
+
+  trace->rec[head & (trace->depth - 1)] = *rec;
+  fgfdm_smp_wmb();
+  trace->head = head + 1;
+}
+
+// reader side: fetch the next record, returns -1 if the ring is empty
+static inline int fgfdm_trace_get(FGFDM_TRACE_T *trace, FGFDM_TRACE_REC_T *rec) {
+  uint32_t tail = trace->tail;
+
+  if (trace->head == tail) {
+    return -1;
+  }
+  fgfdm_smp_rmb();
+
+  *rec = trace->rec[tail & (trace->depth - 1)];
+  // the record must be copied before the writer sees the slot free
+  fgfdm_smp_mb();
+  trace->tail = tail + 1;
+  return 0;
+}
+
 #endif
@@ -0,0 +1,325 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <signal.h>
+#include <arpa/inet.h>
+
+#include "fgfdm.h"
+#include "fgfdm_gen.h"
+
+#define DEFAULT_ITERATIONS 1000000
+
+// lsnr benchmark ends after this idle time without new frames
+#define DEFAULT_IDLE_MS 1000
+
+#define STAGE_SEND_RX   0
+#define STAGE_RX_PUB    1
+#define STAGE_PUB_SEEN  2
+#define STAGE_SEND_SEEN 3
+#define STAGE_COUNT     4
+
+static const char *stage_names[STAGE_COUNT] = { "send-rx", "rx-pub", "pub-seen", "send-seen" };
+
+static const double percentiles[] = { 50.0, 90.0, 99.0, 99.9 };
+#define PERCENTILE_COUNT (sizeof(percentiles) / sizeof(percentiles[0]))
+
+static const char *progname = "fgfdm_bench";
+
+static const char *decode_impls[] = { "scalar", "ssse3", "avx2", NULL };
+
+static volatile sig_atomic_t exit_req = 0;
+
+static long long get_time_ns(void) {
+  struct timespec tp;
+  clock_gettime(CLOCK_MONOTONIC, &tp);
+  return tp.tv_sec * 1000000000LL + tp.tv_nsec;
+}
+
+static void usage(void) {
+  fprintf(stderr, "usage: %s decode [-n iterations]\n", progname);
+  fprintf(stderr, "       %s lsnr [-i index] [-d depth] [-n frames] [-t ms]\n", progname);
+  fprintf(stderr, "  -i index  feed instance of the fgfdm_lsnr under test\n");
+  fprintf(stderr, "  -d depth  shmem ring depth, must match fgfdm_lsnr -d (default %d)\n", FGFDM_RING_DEPTH_DEFAULT);
+  fprintf(stderr, "  -n frames stop after the last of the given number of fgfdm_gen frames\n");
+  fprintf(stderr, "  -t ms     stop after this idle time once frames arrived (default %d)\n", DEFAULT_IDLE_MS);
+}
+
+static void exitHandler(int sig) {
+  exit_req = 1;
+}
+
+// measure ntohfdm cost per frame for every supported implementation
+static int bench_decode(int argc, char **argv) {
+  FGNetFDM frame, work;
+  uint8_t *p;
+  const char **impl;
+  long iterations = DEFAULT_ITERATIONS;
+  long i;
+  long long start, elapsed;
+  volatile uint32_t sink = 0;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "n:")) != -1) {
+    switch (opt) {
+      case 'n':
+        iterations = atol(optarg);
+        break;
+      default:
+        usage();
+        return 1;
+    }
+  }
+
+  // random frame with plausible counts in network byte order
+  p = (uint8_t *) &frame;
+  for (i = 0; i < sizeof(frame); i++) {
+    p[i] = rand();
+  }
+  frame.num_engines = htonl(FG_MAX_ENGINES);
+  frame.num_tanks = htonl(FG_MAX_TANKS);
+  frame.num_wheels = htonl(FG_MAX_WHEELS);
+
+  ntohfdm_init();
+  printf("frame size: %ld bytes, default decoder: %s\n", sizeof(FGNetFDM), ntohfdm_impl());
+
+  for (impl = decode_impls; *impl != NULL; impl++) {
+    if (ntohfdm_select(*impl)) {
+      printf("%-8s not supported\n", *impl);
+      continue;
+    }
+
+    // warm up
+    memcpy(&work, &frame, sizeof(FGNetFDM));
+    for (i = 0; i < 1000; i++) {
+      ntohfdm(&work);
+    }
+
+    // every iteration decodes the frame in place, so the data
+    // alternates between both byte orders like fresh packets
+    start = get_time_ns();
+    for (i = 0; i < iterations; i++) {
+      ntohfdm(&work);
+      sink += work.version;
+    }
+    elapsed = get_time_ns() - start;
+
+    printf("%-8s %8.2f ns/frame (%ld frames)\n", *impl, (double) elapsed / iterations, iterations);
+  }
+
+  return 0;
+}
+
+static int cmp_ll(const void *a, const void *b) {
+  long long x = *(const long long *) a;
+  long long y = *(const long long *) b;
+  return (x > y) - (x < y);
+}
+
+static void print_latency(const char *name, long long *lat, size_t n) {
+  size_t k;
+
+  printf("%-10s %8lu", name, (unsigned long) n);
+  if (n == 0) {
+    printf("\n");
+    return;
+  }
+
+  qsort(lat, n, sizeof(long long), cmp_ll);
+  printf(" %9.1f", lat[0] * 0.001);
+  for (k = 0; k < PERCENTILE_COUNT; k++) {
+    printf(" %9.1f", lat[(size_t) ((n - 1) * percentiles[k] / 100.0 + 0.5)] * 0.001);
+  }
+  printf(" %9.1f\n", lat[n - 1] * 0.001);
+}
+
+// follow the shmem ring of a running fgfdm_lsnr fed by fgfdm_gen and
+// measure throughput, frame loss and latency of every frame
+static int bench_lsnr(int argc, char **argv) {
+  int ret = 1;
+  int instance = 0;
+  int depth = FGFDM_RING_DEPTH_DEFAULT;
+  long frames = 0;
+  int idle_ms = DEFAULT_IDLE_MS;
+  int comp_id, shmem_id;
+  char modname[HAL_NAME_LEN + 1];
+  FGFDM_SHMEM_T *shmem;
+  FGFDM_BUFFER_T buffer;
+  uint32_t mask, head, tail;
+  long long *lat[STAGE_COUNT];
+  size_t n, alloc, k;
+  unsigned long published = 0, valid = 0, invalid = 0, overwritten = 0, torn = 0, reordered = 0;
+  uint32_t seq, first_seq = 0, last_seq = 0;
+  long long now, first_seen = 0, last_seen = 0, send_time;
+  char label[16];
+  int opt, i;
+
+  while ((opt = getopt(argc, argv, "i:d:n:t:")) != -1) {
+    switch (opt) {
+      case 'i':
+        instance = atoi(optarg);
+        break;
+      case 'd':
+        depth = atoi(optarg);
+        break;
+      case 'n':
+        frames = atol(optarg);
+        break;
+      case 't':
+        idle_ms = atoi(optarg);
+        break;
+      default:
+        usage();
+        return 1;
+    }
+  }
+  if (!fgfdm_shmem_depth_valid(depth) || instance < 0) {
+    usage();
+    return 1;
+  }
+  mask = depth - 1;
+
+  alloc = (frames > 0) ? frames : 65536;
+  bzero(lat, sizeof(lat));
+  for (i = 0; i < STAGE_COUNT; i++) {
+    lat[i] = malloc(alloc * sizeof(long long));
+    if (lat[i] == NULL) {
+      fprintf(stderr, "%s: ERROR: out of memory\n", progname);
+      goto fail0;
+    }
+  }
+
+  // attach to the frame ring of the listener
+  snprintf(modname, sizeof(modname), "%s_%d", progname, getpid());
+  comp_id = hal_init(modname);
+  if (comp_id < 1) {
+    fprintf(stderr, "%s: ERROR: hal_init failed\n", progname);
+    goto fail0;
+  }
+  shmem_id = rtapi_shmem_new(FGFDM_SHMEM_KEY + instance, comp_id, fgfdm_shmem_size(depth));
+  if (shmem_id < 0) {
+    fprintf(stderr, "%s: ERROR: couldn't allocate user/RT shared memory\n", progname);
+    goto fail1;
+  }
+  if (fgfdm_rtapi_shmem_getptr(shmem_id, (void **) &shmem)) {
+    fprintf(stderr, "%s: ERROR: couldn't map user/RT shared memory\n", progname);
+    goto fail2;
+  }
+  if (shmem->depth != depth) {
+    fprintf(stderr, "%s: ERROR: ring depth %d does not match listener ring depth %u\n", progname, depth, shmem->depth);
+    goto fail2;
+  }
+
+  signal(SIGINT, exitHandler);
+  signal(SIGTERM, exitHandler);
+  hal_ready(comp_id);
+
+  // spin on the ring, every published frame is inspected once
+  n = 0;
+  tail = fgfdm_shmem_head(shmem);
+  while (!exit_req) {
+    head = fgfdm_shmem_head(shmem);
+    now = get_time_ns();
+    if (head == tail) {
+      if (last_seen != 0 && now - last_seen > idle_ms * 1000000LL) {
+        break;
+      }
+      continue;
+    }
+    if (head - tail > mask) {
+      overwritten += head - tail - mask;
+      tail = head - mask;
+    }
+
+    if (fgfdm_shmem_read(shmem, mask, tail, &buffer)) {
+      torn++;
+      continue;
+    }
+    tail++;
+    published++;
+    last_seen = now;
+
+    if (!buffer.data_valid) {
+      invalid++;
+      continue;
+    }
+
+    seq = fgfdm_gen_seq(&buffer.data);
+    if (valid == 0) {
+      first_seq = seq;
+      first_seen = now;
+    } else if ((int32_t) (seq - last_seq) <= 0) {
+      reordered++;
+      continue;
+    }
+    last_seq = seq;
+    valid++;
+
+    if (n < alloc) {
+      send_time = fgfdm_gen_send_time(&buffer.data);
+      lat[STAGE_SEND_RX][n] = buffer.rx_time - send_time;
+      lat[STAGE_RX_PUB][n] = buffer.pub_time - buffer.rx_time;
+      lat[STAGE_PUB_SEEN][n] = now - buffer.pub_time;
+      lat[STAGE_SEND_SEEN][n] = now - send_time;
+      n++;
+    }
+
+    if (frames > 0 && seq >= frames - 1) {
+      break;
+    }
+  }
+
+  if (valid == 0) {
+    fprintf(stderr, "%s: ERROR: no valid frames received\n", progname);
+    goto fail2;
+  }
+
+  printf("published %lu frames (%lu valid, %lu invalid), %lu overwritten, %lu torn, %lu out of order\n",
+    published, valid, invalid, overwritten, torn, reordered);
+  printf("lost %lu of %u frames (%.3f %%), throughput %.1f frames/s\n",
+    (unsigned long) (last_seq - first_seq + 1 - valid), last_seq - first_seq + 1,
+    100.0 * (last_seq - first_seq + 1 - valid) / (last_seq - first_seq + 1),
+    (last_seen > first_seen) ? (valid - 1) * 1e9 / (last_seen - first_seen) : 0.0);
+
+  printf("latency in us\n");
+  printf("%-10s %8s %9s", "stage", "count", "min");
+  for (k = 0; k < PERCENTILE_COUNT; k++) {
+    snprintf(label, sizeof(label), "p%g", percentiles[k]);
+    printf(" %9s", label);
+  }
+  printf(" %9s\n", "max");
+  for (i = 0; i < STAGE_COUNT; i++) {
+    print_latency(stage_names[i], lat[i], n);
+  }
+
+  ret = 0;
+
+fail2:
+  rtapi_shmem_delete(shmem_id, comp_id);
+fail1:
+  hal_exit(comp_id);
+fail0:
+  for (i = 0; i < STAGE_COUNT; i++) {
+    free(lat[i]);
+  }
+  return ret;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    usage();
+    return 1;
+  }
+
+  if (strcmp(argv[1], "decode") == 0) {
+    return bench_decode(argc - 1, argv + 1);
+  }
+  if (strcmp(argv[1], "lsnr") == 0) {
+    return bench_lsnr(argc - 1, argv + 1);
+  }
+
+  usage();
+  return 1;
+}
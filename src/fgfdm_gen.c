@@ -0,0 +1,245 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "fgfdm_gen.h"
+
+#define DEFAULT_RATE 100
+
+// bad version sent with -v
+#define BAD_VERSION (FG_NET_FDM_VERSION - 1)
+
+static const char *progname = "fgfdm_gen";
+
+static volatile sig_atomic_t exit_req = 0;
+
+static void usage(void) {
+  fprintf(stderr, "usage: %s [options] host port\n", progname);
+  fprintf(stderr, "  -r rate   frames per second (default %d)\n", DEFAULT_RATE);
+  fprintf(stderr, "  -n count  number of valid frames to send (default 0 = endless)\n");
+  fprintf(stderr, "  -j usec   random send time jitter\n");
+  fprintf(stderr, "  -b n      send bursts of n back to back frames at rate / n\n");
+  fprintf(stderr, "  -v pm     per mille of extra frames with a bad version\n");
+  fprintf(stderr, "  -l pm     per mille of extra frames with a wrong length\n");
+  fprintf(stderr, "  -w ms     delay before the first frame\n");
+  fprintf(stderr, "  -s        spin instead of sleeping between frames\n");
+  fprintf(stderr, "  -p prio   run with SCHED_FIFO priority\n");
+  fprintf(stderr, "  -c cpu    pin generator to cpu\n");
+}
+
+static long long get_time_ns(void) {
+  struct timespec tp;
+  clock_gettime(CLOCK_MONOTONIC, &tp);
+  return tp.tv_sec * 1000000000LL + tp.tv_nsec;
+}
+
+static void wait_until(long long t, int spin) {
+  struct timespec ts;
+
+  if (spin) {
+    while (get_time_ns() < t && !exit_req);
+    return;
+  }
+
+  ts.tv_sec = t / 1000000000LL;
+  ts.tv_nsec = t % 1000000000LL;
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR && !exit_req);
+}
+
+static int setup_sched(int prio, int cpu) {
+  struct sched_param sp;
+  cpu_set_t cpus;
+
+  if (cpu >= 0) {
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    if (sched_setaffinity(0, sizeof(cpus), &cpus)) {
+      fprintf(stderr, "%s: ERROR: unable to set cpu affinity to %d\n", progname, cpu);
+      return -1;
+    }
+  }
+
+  if (prio > 0) {
+    if (mlockall(MCL_CURRENT | MCL_FUTURE)) {
+      fprintf(stderr, "%s: WARNING: unable to lock memory\n", progname);
+    }
+    bzero(&sp, sizeof(sp));
+    sp.sched_priority = prio;
+    if (sched_setscheduler(0, SCHED_FIFO, &sp)) {
+      fprintf(stderr, "%s: ERROR: unable to set SCHED_FIFO priority %d\n", progname, prio);
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+// smooth pitch/roll motion with matching rates
+static void fill_frame(FGNetFDM *fdm, double t) {
+  double w = 2.0 * M_PI * 0.5;
+
+  bzero(fdm, sizeof(FGNetFDM));
+  fdm->version = FG_NET_FDM_VERSION;
+  fdm->latitude = 0.8;
+  fdm->longitude = 0.2;
+  fdm->altitude = 1000.0;
+  fdm->phi = 0.2 * sin(w * t);
+  fdm->theta = 0.1 * sin(0.5 * w * t);
+  fdm->phidot = 0.2 * w * cos(w * t);
+  fdm->thetadot = 0.05 * w * cos(0.5 * w * t);
+  fdm->A_X_pilot = fdm->theta * 32.174;
+  fdm->A_Y_pilot = -fdm->phi * 32.174;
+  fdm->A_Z_pilot = -32.174;
+}
+
+static void exitHandler(int sig) {
+  exit_req = 1;
+}
+
+int main(int argc, char **argv) {
+  int ret = 1;
+  int sock;
+  struct sockaddr_in addr;
+  FGNetFDM fdm;
+  double rate = DEFAULT_RATE;
+  long count = 0;
+  int jitter_us = 0;
+  int burst = 1;
+  int bad_version = 0;
+  int bad_length = 0;
+  int delay_ms = 0;
+  int spin = 0;
+  int prio = 0;
+  int cpu = -1;
+  long long start, now, group_ns, t;
+  unsigned long sent = 0, sent_bad_version = 0, sent_bad_length = 0, errors = 0;
+  uint32_t seq;
+  size_t len;
+  int i, opt;
+
+  while ((opt = getopt(argc, argv, "r:n:j:b:v:l:w:sp:c:")) != -1) {
+    switch (opt) {
+      case 'r':
+        rate = atof(optarg);
+        break;
+      case 'n':
+        count = atol(optarg);
+        break;
+      case 'j':
+        jitter_us = atoi(optarg);
+        break;
+      case 'b':
+        burst = atoi(optarg);
+        break;
+      case 'v':
+        bad_version = atoi(optarg);
+        break;
+      case 'l':
+        bad_length = atoi(optarg);
+        break;
+      case 'w':
+        delay_ms = atoi(optarg);
+        break;
+      case 's':
+        spin = 1;
+        break;
+      case 'p':
+        prio = atoi(optarg);
+        break;
+      case 'c':
+        cpu = atoi(optarg);
+        break;
+      default:
+        usage();
+        return 1;
+    }
+  }
+  if (optind != argc - 2 || rate <= 0.0 || burst < 1 || jitter_us < 0) {
+    usage();
+    return 1;
+  }
+
+  bzero(&addr, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(atoi(argv[optind + 1]));
+  if (inet_pton(AF_INET, argv[optind], &addr.sin_addr) != 1) {
+    fprintf(stderr, "%s: ERROR: invalid address %s\n", progname, argv[optind]);
+    return 1;
+  }
+
+  sock = socket(AF_INET, SOCK_DGRAM, 0);
+  if (sock < 0) {
+    fprintf(stderr, "%s: ERROR: unable to create UDP socket\n", progname);
+    return 1;
+  }
+
+  if (setup_sched(prio, cpu)) {
+    goto fail0;
+  }
+
+  signal(SIGINT, exitHandler);
+  signal(SIGTERM, exitHandler);
+
+  ntohfdm_init();
+  srand(1);
+
+  if (delay_ms > 0) {
+    usleep(delay_ms * 1000);
+  }
+
+  ret = 0;
+  group_ns = (long long) (1e9 * burst / rate);
+  start = get_time_ns();
+  for (seq = 0; !exit_req && (count <= 0 || seq < count); ) {
+    // schedule of the next burst, jitter never accumulates
+    t = start + (seq / burst) * group_ns;
+    if (jitter_us > 0) {
+      t += (rand() % jitter_us) * 1000LL;
+    }
+    wait_until(t, spin);
+
+    for (i = 0; i < burst && (count <= 0 || seq < count); i++) {
+      now = get_time_ns();
+      fill_frame(&fdm, (now - start) * 1e-9);
+      fgfdm_gen_tag(&fdm, seq, now);
+      len = sizeof(FGNetFDM);
+
+      // faulty extra frames do not consume a sequence number
+      if (bad_version > 0 && rand() % 1000 < bad_version) {
+        fdm.version = BAD_VERSION;
+        sent_bad_version++;
+      } else if (bad_length > 0 && rand() % 1000 < bad_length) {
+        len = (rand() & 1) ? sizeof(FGNetFDM) - 8 : sizeof(FGNetFDM) / 2;
+        sent_bad_length++;
+      } else {
+        seq++;
+      }
+
+      htonfdm(&fdm);
+      if (sendto(sock, &fdm, len, 0, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        errors++;
+      }
+      sent++;
+    }
+  }
+  now = get_time_ns();
+
+  printf("%s: sent %lu frames (%u valid, %lu bad version, %lu bad length, %lu send errors) in %.3f s, %.1f frames/s\n",
+    progname, sent, seq, sent_bad_version, sent_bad_length, errors, (now - start) * 1e-9, sent * 1e9 / (now - start));
+
+fail0:
+  close(sock);
+  return ret;
+}
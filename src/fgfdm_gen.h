@@ -0,0 +1,28 @@
+#ifndef _FGFDM_GEN_H
+#define _FGFDM_GEN_H
+
+#include <stdint.h>
+
+#include "net_fdm.h"
+
+// Synthetic frames of fgfdm_gen carry a tag for latency and loss
+// measurement: cur_time holds the sequence number of the valid frames
+// and the unused engine state array (num_engines is 0) the send time
+// as CLOCK_MONOTONIC ns.
+
+static inline void fgfdm_gen_tag(FGNetFDM *fdm, uint32_t seq, uint64_t send_time) {
+  fdm->num_engines = 0;
+  fdm->cur_time = seq;
+  fdm->eng_state[0] = send_time >> 32;
+  fdm->eng_state[1] = send_time & 0xffffffff;
+}
+
+static inline uint32_t fgfdm_gen_seq(const FGNetFDM *fdm) {
+  return fdm->cur_time;
+}
+
+static inline uint64_t fgfdm_gen_send_time(const FGNetFDM *fdm) {
+  return ((uint64_t) fdm->eng_state[0] << 32) | fdm->eng_state[1];
+}
+
+#endif
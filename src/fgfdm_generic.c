@@ -0,0 +1,320 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <endian.h>
+#include <arpa/inet.h>
+
+#include "fgfdm_generic.h"
+
+// max. size of a protocol file
+#define FGFDM_GENERIC_FILE_MAX (1024 * 1024)
+
+typedef struct {
+  const char *name;
+  uint16_t type;
+  uint16_t size;
+} FGFDM_GENERIC_TYPE_T;
+
+static const FGFDM_GENERIC_TYPE_T generic_types[] = {
+  { "bool",   FGFDM_GENERIC_TYPE_BOOL,   1 },
+  { "int",    FGFDM_GENERIC_TYPE_INT,    4 },
+  { "float",  FGFDM_GENERIC_TYPE_FLOAT,  4 },
+  { "double", FGFDM_GENERIC_TYPE_DOUBLE, 8 },
+  { NULL }
+};
+
+typedef struct {
+  const char *name;
+  const char *value;
+} FGFDM_GENERIC_SEP_T;
+
+// named separators of the generic protocol, anything else is literal
+static const FGFDM_GENERIC_SEP_T generic_seps[] = {
+  { "newline",        "\n" },
+  { "tab",            "\t" },
+  { "space",          " "  },
+  { "formfeed",       "\f" },
+  { "carriagereturn", "\r" },
+  { "verticaltab",    "\v" },
+  { NULL }
+};
+
+// find <tag>...</tag> in [start, end), returns the content or NULL
+static const char *find_tag(const char *start, const char *end, const char *tag, const char **content_end) {
+  char open[64], close[64];
+  const char *p, *q;
+
+  snprintf(open, sizeof(open), "<%s>", tag);
+  snprintf(close, sizeof(close), "</%s>", tag);
+
+  p = memmem(start, end - start, open, strlen(open));
+  if (p == NULL) {
+    return NULL;
+  }
+  p += strlen(open);
+  q = memmem(p, end - p, close, strlen(close));
+  if (q == NULL) {
+    return NULL;
+  }
+
+  *content_end = q;
+  return p;
+}
+
+// copy the trimmed content of a tag, returns -1 if it is missing
+static int get_tag(const char *start, const char *end, const char *tag, char *out, size_t size) {
+  const char *p, *q;
+  size_t len;
+
+  p = find_tag(start, end, tag, &q);
+  if (p == NULL) {
+    return -1;
+  }
+  while (p < q && isspace((unsigned char) *p)) {
+    p++;
+  }
+  while (q > p && isspace((unsigned char) q[-1])) {
+    q--;
+  }
+
+  len = q - p;
+  if (len >= size) {
+    len = size - 1;
+  }
+  memcpy(out, p, len);
+  out[len] = 0;
+  return 0;
+}
+
+static void get_sep(const char *start, const char *end, const char *tag, char *out, const char *def) {
+  const FGFDM_GENERIC_SEP_T *sep;
+  char buf[FGFDM_GENERIC_SEP_LEN];
+
+  if (get_tag(start, end, tag, buf, sizeof(buf))) {
+    snprintf(out, FGFDM_GENERIC_SEP_LEN, "%s", def);
+    return;
+  }
+
+  for (sep = generic_seps; sep->name != NULL; sep++) {
+    if (strcmp(buf, sep->name) == 0) {
+      snprintf(out, FGFDM_GENERIC_SEP_LEN, "%s", sep->value);
+      return;
+    }
+  }
+  snprintf(out, FGFDM_GENERIC_SEP_LEN, "%s", buf);
+}
+
+// pin name part from the chunk name: lower case, no blanks
+static void make_name(char *out, const char *name, int idx) {
+  int i;
+
+  for (i = 0; name[i] != 0 && i < FGFDM_GENERIC_NAME_LEN - 1; i++) {
+    out[i] = isalnum((unsigned char) name[i]) ? tolower((unsigned char) name[i]) : '-';
+  }
+  out[i] = 0;
+
+  if (i == 0) {
+    snprintf(out, FGFDM_GENERIC_NAME_LEN, "value-%02d", idx);
+  }
+}
+
+static uint32_t layout_hash(const FGFDM_GENERIC_LAYOUT_T *layout) {
+  const uint8_t *p = (const uint8_t *) layout->field;
+  size_t i, len = layout->count * sizeof(FGFDM_GENERIC_FIELD_T);
+  uint32_t h = 2166136261u;
+
+  // FNV-1a
+  for (i = 0; i < len; i++) {
+    h = (h ^ p[i]) * 16777619u;
+  }
+  h = (h ^ layout->binary) * 16777619u;
+  return h ? h : 1;
+}
+
+int fgfdm_generic_load(const char *modname, const char *file, FGFDM_GENERIC_LAYOUT_T *layout) {
+  int ret = -1;
+  FILE *f;
+  char *xml;
+  long size;
+  const char *sec, *sec_end, *chunk, *chunk_end, *p;
+  const FGFDM_GENERIC_TYPE_T *type;
+  FGFDM_GENERIC_FIELD_T *field;
+  char buf[64];
+  char *c;
+  int i, offset;
+
+  f = fopen(file, "r");
+  if (f == NULL) {
+    fprintf(stderr, "%s: ERROR: unable to open protocol file %s\n", modname, file);
+    goto fail0;
+  }
+  fseek(f, 0, SEEK_END);
+  size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  if (size <= 0 || size > FGFDM_GENERIC_FILE_MAX) {
+    fprintf(stderr, "%s: ERROR: invalid protocol file %s\n", modname, file);
+    goto fail1;
+  }
+  xml = malloc(size + 1);
+  if (xml == NULL) {
+    fprintf(stderr, "%s: ERROR: out of memory\n", modname);
+    goto fail1;
+  }
+  if (fread(xml, 1, size, f) != size) {
+    fprintf(stderr, "%s: ERROR: unable to read protocol file %s\n", modname, file);
+    goto fail2;
+  }
+  xml[size] = 0;
+
+  // blank out comments
+  for (c = strstr(xml, "<!--"); c != NULL; c = strstr(c, "<!--")) {
+    for (; *c != 0 && strncmp(c, "-->", 3) != 0; c++) {
+      *c = ' ';
+    }
+    if (*c != 0) {
+      memset(c, ' ', 3);
+    }
+  }
+
+  // FlightGear sends the output section
+  sec = find_tag(xml, xml + size, "output", &sec_end);
+  if (sec == NULL) {
+    fprintf(stderr, "%s: ERROR: no <output> section in protocol file %s\n", modname, file);
+    goto fail2;
+  }
+
+  bzero(layout, sizeof(FGFDM_GENERIC_LAYOUT_T));
+  layout->binary = (get_tag(sec, sec_end, "binary_mode", buf, sizeof(buf)) == 0 && strcmp(buf, "true") == 0);
+  get_sep(sec, sec_end, "var_separator", layout->var_sep, ",");
+  get_sep(sec, sec_end, "line_separator", layout->line_sep, "\n");
+
+  // compile the chunks into the field table
+  offset = 0;
+  for (p = sec; (chunk = find_tag(p, sec_end, "chunk", &chunk_end)) != NULL; p = chunk_end) {
+    if (layout->count >= FGFDM_GENERIC_MAX_FIELDS) {
+      fprintf(stderr, "%s: ERROR: too many chunks in protocol file %s (max. %d)\n", modname, file, (int) FGFDM_GENERIC_MAX_FIELDS);
+      goto fail2;
+    }
+    field = &layout->field[layout->count];
+
+    if (get_tag(chunk, chunk_end, "name", buf, sizeof(buf))) {
+      buf[0] = 0;
+    }
+    make_name(field->name, buf, layout->count);
+    for (i = 0; i < layout->count; i++) {
+      if (strcmp(layout->field[i].name, field->name) == 0) {
+        fprintf(stderr, "%s: ERROR: duplicate chunk name %s in protocol file %s\n", modname, field->name, file);
+        goto fail2;
+      }
+    }
+
+    // int is the default type of the generic protocol
+    if (get_tag(chunk, chunk_end, "type", buf, sizeof(buf))) {
+      strcpy(buf, "int");
+    }
+    for (type = generic_types; type->name != NULL && strcmp(type->name, buf) != 0; type++);
+    if (type->name == NULL) {
+      fprintf(stderr, "%s: ERROR: unsupported chunk type %s in protocol file %s\n", modname, buf, file);
+      goto fail2;
+    }
+
+    field->type = type->type;
+    field->offset = offset;
+    offset += type->size;
+    layout->count++;
+  }
+  if (layout->count == 0) {
+    fprintf(stderr, "%s: ERROR: no chunks in protocol file %s\n", modname, file);
+    goto fail2;
+  }
+
+  // length and magic footers are a single int
+  layout->size = offset;
+  if (get_tag(sec, sec_end, "binary_footer", buf, sizeof(buf)) == 0 && strcmp(buf, "none") != 0) {
+    layout->size += 4;
+  }
+
+  layout->hash = layout_hash(layout);
+  ret = 0;
+
+fail2:
+  free(xml);
+fail1:
+  fclose(f);
+fail0:
+  return ret;
+}
+
+static int decode_binary(const FGFDM_GENERIC_LAYOUT_T *layout, const uint8_t *raw, unsigned int len, double *out) {
+  const FGFDM_GENERIC_FIELD_T *field;
+  const uint8_t *p;
+  uint32_t u32;
+  uint64_t u64;
+  float fv;
+  double dv;
+  int i;
+
+  if (len != layout->size) {
+    return -1;
+  }
+
+  for (i = 0, field = layout->field; i < layout->count; i++, field++) {
+    p = raw + field->offset;
+    switch (field->type) {
+      case FGFDM_GENERIC_TYPE_BOOL:
+        out[i] = (p[0] != 0);
+        break;
+      case FGFDM_GENERIC_TYPE_INT:
+        memcpy(&u32, p, sizeof(u32));
+        out[i] = (int32_t) ntohl(u32);
+        break;
+      case FGFDM_GENERIC_TYPE_FLOAT:
+        memcpy(&u32, p, sizeof(u32));
+        u32 = ntohl(u32);
+        memcpy(&fv, &u32, sizeof(fv));
+        out[i] = fv;
+        break;
+      default:
+        memcpy(&u64, p, sizeof(u64));
+        u64 = be64toh(u64);
+        memcpy(&dv, &u64, sizeof(dv));
+        out[i] = dv;
+        break;
+    }
+  }
+
+  return 0;
+}
+
+static int decode_ascii(const FGFDM_GENERIC_LAYOUT_T *layout, char *raw, unsigned int len, double *out) {
+  size_t sep_len = strlen(layout->var_sep);
+  char *p, *end;
+  int i;
+
+  raw[len] = 0;
+  for (i = 0, p = raw; i < layout->count; i++) {
+    out[i] = strtod(p, &end);
+    if (end == p) {
+      return -1;
+    }
+    p = end;
+
+    if (i < layout->count - 1) {
+      if (strncmp(p, layout->var_sep, sep_len) != 0) {
+        return -1;
+      }
+      p += sep_len;
+    }
+  }
+
+  return 0;
+}
+
+int fgfdm_generic_decode(const FGFDM_GENERIC_LAYOUT_T *layout, char *raw, unsigned int len, double *out) {
+  if (layout->binary) {
+    return decode_binary(layout, (const uint8_t *) raw, len, out);
+  }
+  return decode_ascii(layout, raw, len, out);
+}
@@ -0,0 +1,18 @@
+#ifndef _FGFDM_GENERIC_H
+#define _FGFDM_GENERIC_H
+
+#include "fgfdm.h"
+
+// max. size of a generic protocol datagram
+#define FGFDM_GENERIC_RAW_SIZE 4096
+
+// compile the <output> section of a FlightGear generic protocol file
+// into a flat field table, returns -1 on error
+extern int fgfdm_generic_load(const char *modname, const char *file, FGFDM_GENERIC_LAYOUT_T *layout);
+
+// decode a datagram into host doubles, returns -1 if it does not match
+// the layout (ascii datagrams are terminated in place, so raw must
+// have room for one more byte)
+extern int fgfdm_generic_decode(const FGFDM_GENERIC_LAYOUT_T *layout, char *raw, unsigned int len, double *out);
+
+#endif
@@ -1,29 +1,1008 @@
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <unistd.h>
 #include <string.h>
 #include <signal.h>
 #include <errno.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 #include <sys/eventfd.h>
 #include <sys/socket.h>
+#include <sys/mman.h>
+#include <poll.h>
+#include <net/if.h>
 #include <netinet/in.h>
+#include <arpa/inet.h>
+#include <linux/if_packet.h>
+#include <linux/if_ether.h>
+#include <linux/filter.h>
 
 #include "fgfdm.h"
+#include "fgfdm_generic.h"
+
+// max. number of datagrams fetched per wakeup
+#define FGFDM_LSNR_BATCH 16
+
+// number of log2 buckets of the jitter histogram (1us .. 32ms)
+#define FGFDM_LSNR_JITTER_BUCKETS 16
+
+// window of the packet rate measurement in ns
+#define FGFDM_LSNR_RATE_WINDOW 1000000000LL
+
+// PACKET_MMAP receive ring (-I), frames hold one datagram of up to
+// FG_NET_FDM_WIRE_MAX bytes with all headers
+#define FGFDM_LSNR_PKT_FRAME_SIZE 2048
+#define FGFDM_LSNR_PKT_BLOCK_SIZE (64 * 1024)
+#define FGFDM_LSNR_PKT_BLOCKS 8
+
+// max. number of allowed sources (-A)
+#define FGFDM_LSNR_SOURCES_MAX 8
+
+// source failover after this many mean frame intervals without data
+#define FGFDM_LSNR_FAILOVER_INTERVALS 1.5
+
+// recording file header, followed by records that hold only the
+// received bytes of each datagram, so they are walked sequentially
+#define FGFDM_LSNR_REC_MAGIC "FGRC"
+#define FGFDM_LSNR_REC_VERSION 3
 
 typedef struct {
   hal_bit_t *data_valid;
   hal_u32_t *timestamp;
   hal_u32_t *msgno;
+
+  // telemetry
+  hal_u32_t *rx_packets;
+  hal_u32_t *rx_malformed;
+  hal_u32_t *rx_bad_version;
+  hal_u32_t *rx_overflow;
+  hal_u32_t *rx_coalesced;
+  hal_u32_t *rx_ring_full;
+  hal_u32_t *rx_rejected;
+  hal_s32_t *active_source;
+  hal_u32_t *failovers;
+  hal_float_t *packet_rate;
+  hal_float_t *interval_us;
+  hal_float_t *jitter_us;
+  hal_u32_t *jitter_hist[FGFDM_LSNR_JITTER_BUCKETS];
 } FGFDM_LSNR_HAL_T;
 
-static const char *modname = FGFDM_MODULE_NAME "_lsnr";
+typedef struct {
+  struct sockaddr_in from;
+  struct iovec iov[2];
+  char cmsg_buf[CMSG_SPACE(sizeof(struct timespec)) + CMSG_SPACE(sizeof(uint32_t))];
+  long long rx_time;
+} FGFDM_LSNR_MSG_T;
+
+typedef struct {
+  char magic[4];
+  uint32_t version;
+  // max. number of datagram bytes per record
+  uint32_t max_len;
+  uint32_t fdm_version;
+} FGFDM_LSNR_REC_HDR_T;
+
+typedef struct {
+  // receive time (CLOCK_MONOTONIC ns)
+  uint64_t rx_time;
+  // received length and recvmsg flags, followed by the raw datagram
+  // in network byte order (truncated to FG_NET_FDM_WIRE_MAX)
+  uint32_t len;
+  uint32_t flags;
+} FGFDM_LSNR_REC_T;
+
+static inline uint32_t rec_data_len(uint32_t len) {
+  return (len < FG_NET_FDM_WIRE_MAX) ? len : FG_NET_FDM_WIRE_MAX;
+}
+
+typedef struct {
+  struct in_addr addr;
+  long long last_rx;
+  // smoothed frame interval in ns
+  double interval;
+} FGFDM_LSNR_SOURCE_T;
+
+typedef struct {
+  long long last_rx;
+  double interval;
+  double jitter;
+  long long rate_start;
+  uint32_t rate_packets;
+  long long next_dump;
+} FGFDM_LSNR_STATS_T;
+
+static char modname[HAL_NAME_LEN + 1] = FGFDM_MODULE_NAME "_lsnr";
+static char prefix[HAL_NAME_LEN + 1] = FGFDM_MODULE_NAME;
 static int hal_comp_id;
 static FGFDM_LSNR_HAL_T *hal_data;
 
 static int lsnr_sock = -1;
+static volatile sig_atomic_t exit_req = 0;
 
 static int shmem_id;
+static FGFDM_SHMEM_T *shmem;
+static uint32_t ring_mask;
+
+static FGFDM_LSNR_MSG_T msg_buf[FGFDM_LSNR_BATCH];
+static struct mmsghdr msg_hdr[FGFDM_LSNR_BATCH];
+
+// part of datagrams beyond FGNetFDM (other wire versions)
+static uint8_t wire_tail[FG_NET_FDM_WIRE_MAX - sizeof(FGNetFDM)];
+
+static int warn_shown;
+
+static FGFDM_LSNR_STATS_T stats;
+static long long dump_interval;
+
+static FILE *rec_file;
+static unsigned long rec_count;
+
+// allowed sources, the first two are primary and standby in redundant mode
+static FGFDM_LSNR_SOURCE_T sources[FGFDM_LSNR_SOURCES_MAX];
+static int source_count;
+static int redundant;
+static int active_source;
+static long long failover_ns;
+static long long source_start;
+
+static int pkt_fd = -1;
+static uint8_t *pkt_map;
+static unsigned int pkt_frames;
+static unsigned int pkt_next;
+
+static int generic;
+static FGFDM_GENERIC_LAYOUT_T gen_layout;
+static char gen_raw[FGFDM_GENERIC_RAW_SIZE + 1];
+
+static void usage(void) {
+  fprintf(stderr, "usage: %s [options] port\n", modname);
+  fprintf(stderr, "       %s [options] -R file\n", modname);
+  fprintf(stderr, "  -i index  feed instance, matches fgfdm count=/names= position\n");
+  fprintf(stderr, "  -n name   pin prefix, must match the fgfdm instance name\n");
+  fprintf(stderr, "  -d depth  shmem ring depth (power of two, default %d)\n", FGFDM_RING_DEPTH_DEFAULT);
+  fprintf(stderr, "  -a        publish all datagrams, not only the newest one of a batch\n");
+  fprintf(stderr, "  -b usec   enable socket busy polling (SO_BUSY_POLL)\n");
+  fprintf(stderr, "  -s        spin on the socket instead of blocking\n");
+  fprintf(stderr, "  -I ifname receive from a PACKET_MMAP ring on ifname instead of the UDP socket\n");
+  fprintf(stderr, "  -m group  join multicast group\n");
+  fprintf(stderr, "  -A list   accept datagrams only from this comma separated list of addresses\n");
+  fprintf(stderr, "  -H p,s    redundant feeds: use primary p, fail over to standby s and back\n");
+  fprintf(stderr, "  -F ms     failover timeout (default %.1f mean frame intervals)\n", FGFDM_LSNR_FAILOVER_INTERVALS);
+  fprintf(stderr, "  -p prio   run with SCHED_FIFO priority\n");
+  fprintf(stderr, "  -c cpu    pin listener to cpu\n");
+  fprintf(stderr, "  -t sec    dump telemetry to stderr every sec seconds\n");
+  fprintf(stderr, "  -g file   receive FlightGear generic protocol described by file\n");
+  fprintf(stderr, "  -r file   record all datagrams to file (implies -a)\n");
+  fprintf(stderr, "  -R file   replay a recording instead of listening\n");
+  fprintf(stderr, "  -x speed  replay speed factor (default 1.0, 0 = as fast as possible)\n");
+  fprintf(stderr, "  -l        loop the replay\n");
+}
+
+// get the kernel receive time of a message as CLOCK_MONOTONIC ns
+// and the socket drop counter if present
+static long long get_rx_time(struct msghdr *mh, uint32_t *drops) {
+  struct cmsghdr *cmsg;
+  struct timespec *stamp, now_real;
+  long long now_mono, rx_time, age;
+
+  now_mono = fgfdm_get_time_ns();
+  rx_time = now_mono;
+
+  for (cmsg = CMSG_FIRSTHDR(mh); cmsg != NULL; cmsg = CMSG_NXTHDR(mh, cmsg)) {
+    if (cmsg->cmsg_level != SOL_SOCKET) {
+      continue;
+    }
+
+    if (cmsg->cmsg_type == SO_RXQ_OVFL) {
+      memcpy(drops, CMSG_DATA(cmsg), sizeof(uint32_t));
+      continue;
+    }
+
+    if (cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+      // kernel stamps are CLOCK_REALTIME, so convert them via their age
+      stamp = (struct timespec *) CMSG_DATA(cmsg);
+      clock_gettime(CLOCK_REALTIME, &now_real);
+      age = (now_real.tv_sec - stamp->tv_sec) * 1000000000LL + (now_real.tv_nsec - stamp->tv_nsec);
+      if (age < 0) {
+        age = 0;
+      }
+      rx_time = now_mono - age;
+    }
+  }
+
+  return rx_time;
+}
+
+// update inter-arrival statistics, the deviation from the mean
+// interval is smoothed like the RFC 3550 interarrival jitter
+static void update_arrival(long long rx_time) {
+  long long interval;
+  double dev;
+  int i;
+
+  interval = rx_time - stats.last_rx;
+  stats.last_rx = rx_time;
+  if (interval <= 0 || interval > FGFDM_LISTENER_TIMEOUT * 1000000LL) {
+    return;
+  }
+
+  if (stats.interval == 0.0) {
+    stats.interval = interval;
+  }
+  dev = interval - stats.interval;
+  stats.interval += dev / 16.0;
+  if (dev < 0.0) {
+    dev = -dev;
+  }
+  stats.jitter += (dev - stats.jitter) / 16.0;
+
+  *(hal_data->interval_us) = stats.interval * 0.001;
+  *(hal_data->jitter_us) = stats.jitter * 0.001;
+
+  // log2 histogram of the deviation in us, last bucket collects the rest
+  for (i = 0, dev *= 0.001; dev >= 1.0 && i < FGFDM_LSNR_JITTER_BUCKETS - 1; i++, dev *= 0.5);
+  (*(hal_data->jitter_hist[i]))++;
+}
+
+// account all datagrams of a batch
+static void update_stats(int n) {
+  FGFDM_LSNR_MSG_T *m;
+  struct msghdr *mh;
+  uint32_t drops;
+  int i;
+
+  drops = *(hal_data->rx_overflow);
+  for (i = 0; i < n; i++) {
+    m = &msg_buf[i];
+    mh = &msg_hdr[i].msg_hdr;
+
+    m->rx_time = get_rx_time(mh, &drops);
+    update_arrival(m->rx_time);
+
+    // generic ascii datagrams are only checked by decoding
+    if (generic) {
+      if ((mh->msg_flags & MSG_TRUNC) || (gen_layout.binary && msg_hdr[i].msg_len != gen_layout.size)) {
+        (*(hal_data->rx_malformed))++;
+      }
+    } else if (!ntohfdm_size_valid(msg_hdr[i].msg_len) || (mh->msg_flags & MSG_TRUNC)) {
+      (*(hal_data->rx_malformed))++;
+    }
+  }
+
+  *(hal_data->rx_packets) += n;
+  *(hal_data->rx_coalesced) += n - 1;
+  *(hal_data->rx_overflow) = drops;
+}
+
+// update packet rate and dump telemetry if requested
+static void update_rate(long long now) {
+  long long elapsed;
+  int i;
+
+  elapsed = now - stats.rate_start;
+  if (elapsed >= FGFDM_LSNR_RATE_WINDOW) {
+    *(hal_data->packet_rate) = (*(hal_data->rx_packets) - stats.rate_packets) * 1e9 / elapsed;
+    stats.rate_start = now;
+    stats.rate_packets = *(hal_data->rx_packets);
+  }
+
+  if (dump_interval <= 0 || now < stats.next_dump) {
+    return;
+  }
+  stats.next_dump = now + dump_interval;
+
+  fprintf(stderr, "%s: rx %u malformed %u bad-version %u overflow %u coalesced %u ring-full %u rejected %u rate %.1f/s interval %.1fus jitter %.1fus\n",
+    modname, *(hal_data->rx_packets), *(hal_data->rx_malformed), *(hal_data->rx_bad_version),
+    *(hal_data->rx_overflow), *(hal_data->rx_coalesced), *(hal_data->rx_ring_full), *(hal_data->rx_rejected), *(hal_data->packet_rate),
+    *(hal_data->interval_us), *(hal_data->jitter_us));
+  fprintf(stderr, "%s: jitter histogram (log2 us):", modname);
+  for (i = 0; i < FGFDM_LSNR_JITTER_BUCKETS; i++) {
+    fprintf(stderr, " %u", *(hal_data->jitter_hist[i]));
+  }
+  fprintf(stderr, "\n");
+}
+
+// parse a comma separated address list into the source table
+static int parse_sources(const char *list) {
+  char buf[INET_ADDRSTRLEN];
+  const char *p, *end;
+  size_t len;
+
+  for (p = list; *p != 0; p = (*end == ',') ? end + 1 : end) {
+    end = strchr(p, ',');
+    if (end == NULL) {
+      end = p + strlen(p);
+    }
+    len = end - p;
+    if (len == 0 || len >= sizeof(buf) || source_count >= FGFDM_LSNR_SOURCES_MAX) {
+      return -1;
+    }
+    memcpy(buf, p, len);
+    buf[len] = 0;
+    if (inet_pton(AF_INET, buf, &sources[source_count].addr) != 1) {
+      return -1;
+    }
+    source_count++;
+  }
+
+  return (source_count > 0) ? 0 : -1;
+}
+
+// time without data after which a feed with the given frame
+// interval counts as failed
+static long long source_timeout(double interval) {
+  if (failover_ns > 0) {
+    return failover_ns;
+  }
+  if (interval > 0.0) {
+    return interval * FGFDM_LSNR_FAILOVER_INTERVALS;
+  }
+  return FGFDM_LISTENER_TIMEOUT * 1000000LL;
+}
+
+// decide if the datagram idx is published: unknown sources are
+// rejected, in redundant mode only the active feed is used and the
+// other one takes over with its first frame after the active one
+// missed a frame
+static int check_source(int idx) {
+  const FGFDM_LSNR_MSG_T *m = &msg_buf[idx];
+  FGFDM_LSNR_SOURCE_T *src, *active;
+  long long interval, last;
+  char addr[INET_ADDRSTRLEN];
+  int i;
+
+  if (source_count == 0) {
+    return 1;
+  }
+
+  for (i = 0; i < source_count && sources[i].addr.s_addr != m->from.sin_addr.s_addr; i++);
+  if (i == source_count) {
+    (*(hal_data->rx_rejected))++;
+    return 0;
+  }
+
+  // track the frame interval of every feed
+  src = &sources[i];
+  interval = m->rx_time - src->last_rx;
+  if (src->last_rx != 0 && interval > 0 && interval < FGFDM_LISTENER_TIMEOUT * 1000000LL) {
+    src->interval = (src->interval == 0.0) ? interval : src->interval + (interval - src->interval) / 16.0;
+  }
+  src->last_rx = m->rx_time;
+  if (source_start == 0) {
+    source_start = m->rx_time;
+  }
+
+  if (!redundant || i == active_source) {
+    return 1;
+  }
+
+  // an active feed that never sent is timed from the first frame of
+  // any feed with the frame interval of the other feed
+  active = &sources[active_source];
+  last = (active->last_rx != 0) ? active->last_rx : source_start;
+  if (m->rx_time - last <= source_timeout((active->interval > 0.0) ? active->interval : src->interval)) {
+    (*(hal_data->rx_rejected))++;
+    return 0;
+  }
+
+  active_source = i;
+  *(hal_data->active_source) = i;
+  (*(hal_data->failovers))++;
+  inet_ntop(AF_INET, &src->addr, addr, sizeof(addr));
+  fprintf(stderr, "%s: switching to %s feed %s\n", modname, (i == 0) ? "primary" : "standby", addr);
+  return 1;
+}
+
+// join the multicast group, on ifname if given
+static int join_group(const char *group, const char *ifname) {
+  struct ip_mreqn mreq;
+
+  bzero(&mreq, sizeof(mreq));
+  if (inet_pton(AF_INET, group, &mreq.imr_multiaddr) != 1 || !IN_MULTICAST(ntohl(mreq.imr_multiaddr.s_addr))) {
+    fprintf(stderr, "%s: ERROR: invalid multicast group %s\n", modname, group);
+    return -1;
+  }
+  mreq.imr_address.s_addr = htonl(INADDR_ANY);
+  mreq.imr_ifindex = (ifname != NULL) ? if_nametoindex(ifname) : 0;
+  if (setsockopt(lsnr_sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, (void *) &mreq, sizeof(mreq))) {
+    fprintf(stderr, "%s: ERROR: unable to join multicast group %s\n", modname, group);
+    return -1;
+  }
+
+  return 0;
+}
+
+// all datagrams of a batch are received into the same shmem slot
+// (or raw buffer for the generic protocol), so it holds the newest
+// one when recvmmsg returns, wire versions larger than FGNetFDM
+// spill into wire_tail
+static void init_msg_hdr(FGFDM_BUFFER_T *buffer) {
+  int i;
+  FGFDM_LSNR_MSG_T *m;
+  struct msghdr *mh;
+
+  for (i = 0; i < FGFDM_LSNR_BATCH; i++) {
+    m = &msg_buf[i];
+    mh = &msg_hdr[i].msg_hdr;
+
+    bzero(mh, sizeof(struct msghdr));
+    mh->msg_name = &m->from;
+    mh->msg_namelen = sizeof(m->from);
+    mh->msg_iov = m->iov;
+    if (generic) {
+      m->iov[0].iov_base = gen_raw;
+      m->iov[0].iov_len = FGFDM_GENERIC_RAW_SIZE;
+      mh->msg_iovlen = 1;
+    } else {
+      m->iov[0].iov_base = &buffer->data;
+      m->iov[0].iov_len = sizeof(FGNetFDM);
+      m->iov[1].iov_base = wire_tail;
+      m->iov[1].iov_len = sizeof(wire_tail);
+      mh->msg_iovlen = 2;
+    }
+
+    mh->msg_control = m->cmsg_buf;
+    mh->msg_controllen = sizeof(m->cmsg_buf);
+  }
+}
+
+// stamp the publish time and release the slot to the readers
+static void commit_msg(FGFDM_BUFFER_T *buffer) {
+  buffer->pub_time = fgfdm_get_time_ns();
+  fgfdm_shmem_write_commit(shmem, buffer);
+}
+
+// decode the datagram received into the reserved slot in place and
+// publish it, returns -1 if the slot stays reserved (rejected datagrams
+// are only counted here, readers keep the last good frame)
+static int publish_msg(FGFDM_BUFFER_T *buffer, int idx) {
+  FGNetFDM *msg = &buffer->data;
+  struct msghdr *mh = &msg_hdr[idx].msg_hdr;
+  unsigned int n = msg_hdr[idx].msg_len;
+  long long rx_time = msg_buf[idx].rx_time;
+  uint32_t ts;
+  int ret;
+
+  ts = rx_time / 1000000LL;
+
+  // set timestamp
+  buffer->data_valid = 0;
+  buffer->timestamp = ts;
+  buffer->rx_time = rx_time;
+  buffer->msgno = *(hal_data->msgno);
+
+  if (generic) {
+    // decode generic protocol datagram with the compiled layout
+    if ((mh->msg_flags & MSG_TRUNC) || fgfdm_generic_decode(&gen_layout, gen_raw, n, buffer->generic)) {
+      *(hal_data->data_valid) = 0;
+      if (!gen_layout.binary) {
+        (*(hal_data->rx_malformed))++;
+      }
+      if (!warn_shown) {
+        warn_shown = 1;
+        fprintf(stderr, "%s: WARNING: datagram does not match the generic protocol (length %u)\n", modname, n);
+      }
+      return -1;
+    }
+  } else {
+    // check data size
+    if (!ntohfdm_size_valid(n) || (mh->msg_flags & MSG_TRUNC)) {
+      *(hal_data->data_valid) = 0;
+      if (!warn_shown) {
+        warn_shown = 1;
+        fprintf(stderr, "%s: WARNING: invalid data length (is: %u)\n", modname, n);
+      }
+      return -1;
+    }
+
+    // convert to host byte order with the decoder of the wire version
+    ret = ntohfdm_any(msg, wire_tail, n);
+    if (ret == FG_NET_FDM_ERR_VERSION) {
+      *(hal_data->data_valid) = 0;
+      (*(hal_data->rx_bad_version))++;
+      if (!warn_shown) {
+        warn_shown = 1;
+        fprintf(stderr, "%s: WARNING: invalid data version (is: %u supported: %s)\n", modname, ntohl(msg->version), ntohfdm_versions());
+      }
+      return -1;
+    }
+    if (ret) {
+      // size of another version
+      *(hal_data->data_valid) = 0;
+      (*(hal_data->rx_malformed))++;
+      if (!warn_shown) {
+        warn_shown = 1;
+        fprintf(stderr, "%s: WARNING: invalid data length for version %u (is: %u)\n", modname, ntohl(msg->version), n);
+      }
+      return -1;
+    }
+  }
+
+  // do not overrun readers that consume every frame
+  if (fgfdm_shmem_full(shmem)) {
+    (*(hal_data->rx_ring_full))++;
+    return -1;
+  }
+
+  // now data is valid
+  buffer->data_valid = 1;
+  commit_msg(buffer);
+  warn_shown = 0;
+
+  // update status pins
+  *(hal_data->data_valid) = 1;
+  *(hal_data->timestamp) = ts;
+  (*(hal_data->msgno))++;
+  return 0;
+}
+
+static int open_recording(const char *file) {
+  FGFDM_LSNR_REC_HDR_T hdr;
+
+  rec_file = fopen(file, "wb");
+  if (rec_file == NULL) {
+    fprintf(stderr, "%s: ERROR: unable to create recording %s\n", modname, file);
+    return -1;
+  }
+
+  // large stdio buffer, keeps write syscalls off the per-packet path
+  setvbuf(rec_file, NULL, _IOFBF, 256 * (sizeof(FGFDM_LSNR_REC_T) + FG_NET_FDM_WIRE_MAX));
+
+  memcpy(hdr.magic, FGFDM_LSNR_REC_MAGIC, sizeof(hdr.magic));
+  hdr.version = FGFDM_LSNR_REC_VERSION;
+  hdr.max_len = FG_NET_FDM_WIRE_MAX;
+  hdr.fdm_version = FG_NET_FDM_VERSION;
+  if (fwrite(&hdr, sizeof(hdr), 1, rec_file) != 1) {
+    fprintf(stderr, "%s: ERROR: unable to write recording %s\n", modname, file);
+    fclose(rec_file);
+    rec_file = NULL;
+    return -1;
+  }
+
+  return 0;
+}
+
+// append the raw datagram, must be called before it is decoded in place
+static void record_msg(FGFDM_BUFFER_T *buffer, int idx) {
+  FGFDM_LSNR_REC_T rec;
+  uint32_t len, head;
+
+  rec.rx_time = msg_buf[idx].rx_time;
+  rec.len = msg_hdr[idx].msg_len;
+  rec.flags = msg_hdr[idx].msg_hdr.msg_flags;
+
+  // the datagram was received into the slot and wire_tail
+  len = rec_data_len(rec.len);
+  head = (len < sizeof(FGNetFDM)) ? len : sizeof(FGNetFDM);
+  if (fwrite(&rec, sizeof(rec), 1, rec_file) != 1 ||
+      fwrite(&buffer->data, 1, head, rec_file) != head ||
+      fwrite(wire_tail, 1, len - head, rec_file) != len - head) {
+    fprintf(stderr, "%s: ERROR: unable to write recording, recording stopped\n", modname);
+    fclose(rec_file);
+    rec_file = NULL;
+    return;
+  }
+  rec_count++;
+}
+
+// get the record at pos, returns its datagram bytes or NULL at the
+// end of the file (a record cut off by an aborted recording is dropped)
+static const uint8_t *read_rec(const uint8_t *pos, const uint8_t *end, FGFDM_LSNR_REC_T *rec) {
+  if (end - pos < sizeof(FGFDM_LSNR_REC_T)) {
+    return NULL;
+  }
+
+  // records are packed, so the header may be unaligned
+  memcpy(rec, pos, sizeof(FGFDM_LSNR_REC_T));
+  pos += sizeof(FGFDM_LSNR_REC_T);
+  if (end - pos < rec_data_len(rec->len)) {
+    return NULL;
+  }
+
+  return pos;
+}
+
+// feed a recording into the shmem ring with its original timing
+// scaled by speed (speed <= 0 replays as fast as possible)
+static int replay(const char *file, double speed, int loop) {
+  int ret = -1;
+  int fd;
+  struct stat st;
+  void *map;
+  const FGFDM_LSNR_REC_HDR_T *hdr;
+  FGFDM_LSNR_REC_T rec;
+  const uint8_t *recs, *pos, *end, *data;
+  uint32_t len, head;
+  unsigned long count, loops;
+  long long start, first, target, now;
+  struct timespec ts;
+  FGFDM_BUFFER_T *buffer;
+
+  fd = open(file, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "%s: ERROR: unable to open recording %s\n", modname, file);
+    goto fail0;
+  }
+  if (fstat(fd, &st) || st.st_size < sizeof(FGFDM_LSNR_REC_HDR_T)) {
+    fprintf(stderr, "%s: ERROR: %s is not a recording\n", modname, file);
+    goto fail1;
+  }
+  map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (map == MAP_FAILED) {
+    fprintf(stderr, "%s: ERROR: unable to map recording %s\n", modname, file);
+    goto fail1;
+  }
+
+  hdr = map;
+  if (memcmp(hdr->magic, FGFDM_LSNR_REC_MAGIC, sizeof(hdr->magic)) ||
+      hdr->version != FGFDM_LSNR_REC_VERSION || hdr->max_len != FG_NET_FDM_WIRE_MAX) {
+    fprintf(stderr, "%s: ERROR: %s is not a recording\n", modname, file);
+    goto fail2;
+  }
+  recs = (const uint8_t *) (hdr + 1);
+  end = (const uint8_t *) map + st.st_size;
+  if (read_rec(recs, end, &rec) == NULL) {
+    fprintf(stderr, "%s: ERROR: recording %s is empty\n", modname, file);
+    goto fail2;
+  }
+  madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+  // replayed datagrams carry no control messages
+  buffer = fgfdm_shmem_write_begin(shmem, ring_mask);
+  init_msg_hdr(buffer);
+  msg_hdr[0].msg_hdr.msg_controllen = 0;
+
+  ret = 0;
+  loops = 0;
+  count = 0;
+  do {
+    start = fgfdm_get_time_ns();
+    read_rec(recs, end, &rec);
+    first = rec.rx_time;
+    for (pos = recs; (data = read_rec(pos, end, &rec)) != NULL && !exit_req; pos = data + len) {
+      len = rec_data_len(rec.len);
+
+      // wait for the scaled receive time
+      if (speed > 0.0) {
+        target = start + (long long) ((rec.rx_time - first) / speed);
+        ts.tv_sec = target / 1000000000LL;
+        ts.tv_nsec = target % 1000000000LL;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR && !exit_req);
+      }
+
+      head = (len < sizeof(FGNetFDM)) ? len : sizeof(FGNetFDM);
+      memcpy(&buffer->data, data, head);
+      memcpy(wire_tail, data + head, len - head);
+      msg_hdr[0].msg_len = rec.len;
+      msg_hdr[0].msg_hdr.msg_flags = rec.flags;
+
+      // readers that consume every frame pace the replay
+      while (fgfdm_shmem_full(shmem) && !exit_req) {
+        usleep(1000);
+      }
+
+      now = fgfdm_get_time_ns();
+      update_stats(1);
+      if (publish_msg(buffer, 0) == 0) {
+        buffer = fgfdm_shmem_write_begin(shmem, ring_mask);
+      }
+      update_rate(now);
+      count++;
+    }
+    loops++;
+  } while (loop && !exit_req);
+
+  fprintf(stderr, "%s: replayed %lu records (%lu loops)\n", modname, count, loops);
+
+  // keep the pins alive until terminated
+  *(hal_data->data_valid) = 0;
+  while (!exit_req) {
+    usleep(100000);
+  }
+
+fail2:
+  munmap(map, st.st_size);
+fail1:
+  close(fd);
+fail0:
+  return ret;
+}
+
+// open a PACKET_MMAP ring on ifname that only gets IPv4/UDP datagrams
+// for port, the UDP socket stays bound so the kernel does not answer
+// with port unreachable, but is never read
+static int open_pkt_ring(const char *ifname, int port) {
+  struct sock_filter filter[] = {
+    BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 12),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ETH_P_IP, 0, 8),
+    BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 23),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_UDP, 0, 6),
+    // no fragments
+    BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 20),
+    BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, 0x1fff, 4, 0),
+    // destination port behind the IP header
+    BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, 14),
+    BPF_STMT(BPF_LD | BPF_H | BPF_IND, 16),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, port, 0, 1),
+    BPF_STMT(BPF_RET | BPF_K, 0xffff),
+    BPF_STMT(BPF_RET | BPF_K, 0),
+  };
+  struct sock_fprog prog;
+  struct tpacket_req req;
+  struct sockaddr_ll addr;
+  int ifindex, version, rcvbuf;
+
+  ifindex = if_nametoindex(ifname);
+  if (ifindex == 0) {
+    fprintf(stderr, "%s: ERROR: unknown interface %s\n", modname, ifname);
+    return -1;
+  }
+
+  // no protocol until bound, so nothing unfiltered gets queued
+  pkt_fd = socket(AF_PACKET, SOCK_RAW, 0);
+  if (pkt_fd < 0) {
+    fprintf(stderr, "%s: ERROR: unable to create packet socket (needs CAP_NET_RAW)\n", modname);
+    return -1;
+  }
+
+  prog.len = sizeof(filter) / sizeof(filter[0]);
+  prog.filter = filter;
+  if (setsockopt(pkt_fd, SOL_SOCKET, SO_ATTACH_FILTER, (void *) &prog, sizeof(prog))) {
+    fprintf(stderr, "%s: ERROR: unable to attach packet filter\n", modname);
+    return -1;
+  }
+
+  version = TPACKET_V2;
+  if (setsockopt(pkt_fd, SOL_PACKET, PACKET_VERSION, (void *) &version, sizeof(version))) {
+    fprintf(stderr, "%s: ERROR: unable to select TPACKET_V2\n", modname);
+    return -1;
+  }
+
+  req.tp_block_size = FGFDM_LSNR_PKT_BLOCK_SIZE;
+  req.tp_block_nr = FGFDM_LSNR_PKT_BLOCKS;
+  req.tp_frame_size = FGFDM_LSNR_PKT_FRAME_SIZE;
+  req.tp_frame_nr = FGFDM_LSNR_PKT_BLOCKS * (FGFDM_LSNR_PKT_BLOCK_SIZE / FGFDM_LSNR_PKT_FRAME_SIZE);
+  if (setsockopt(pkt_fd, SOL_PACKET, PACKET_RX_RING, (void *) &req, sizeof(req))) {
+    fprintf(stderr, "%s: ERROR: unable to setup packet ring\n", modname);
+    return -1;
+  }
+  pkt_map = mmap(NULL, FGFDM_LSNR_PKT_BLOCKS * FGFDM_LSNR_PKT_BLOCK_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, pkt_fd, 0);
+  if (pkt_map == MAP_FAILED) {
+    pkt_map = NULL;
+    fprintf(stderr, "%s: ERROR: unable to map packet ring\n", modname);
+    return -1;
+  }
+  pkt_frames = req.tp_frame_nr;
+  pkt_next = 0;
+
+  bzero(&addr, sizeof(addr));
+  addr.sll_family = AF_PACKET;
+  addr.sll_protocol = htons(ETH_P_IP);
+  addr.sll_ifindex = ifindex;
+  if (bind(pkt_fd, (struct sockaddr *) &addr, sizeof(addr))) {
+    fprintf(stderr, "%s: ERROR: unable to bind packet socket to %s\n", modname, ifname);
+    return -1;
+  }
+
+  // the socket queue only sinks the datagrams
+  rcvbuf = 1;
+  setsockopt(lsnr_sock, SOL_SOCKET, SO_RCVBUF, (void *) &rcvbuf, sizeof(rcvbuf));
+
+  return 0;
+}
+
+static void close_pkt_ring(void) {
+  if (pkt_map != NULL) {
+    munmap(pkt_map, FGFDM_LSNR_PKT_BLOCKS * FGFDM_LSNR_PKT_BLOCK_SIZE);
+  }
+  if (pkt_fd >= 0) {
+    close(pkt_fd);
+  }
+}
+
+static struct tpacket2_hdr *pkt_frame(unsigned int idx) {
+  return (struct tpacket2_hdr *) (pkt_map + (idx % pkt_frames) * FGFDM_LSNR_PKT_FRAME_SIZE);
+}
+
+// hand a frame back to the kernel
+static void pkt_release(struct tpacket2_hdr *hdr) {
+  fgfdm_smp_wmb();
+  hdr->tp_status = TP_STATUS_KERNEL;
+}
+
+// ring frames dropped by the kernel count as socket overflows
+static void pkt_account_drops(void) {
+  struct tpacket_stats st;
+  socklen_t len = sizeof(st);
+
+  if (getsockopt(pkt_fd, SOL_PACKET, PACKET_STATISTICS, (void *) &st, &len) == 0) {
+    *(hal_data->rx_overflow) += st.tp_drops;
+  }
+}
+
+// fill message idx as recvmmsg would have, the payload is only
+// copied into the iov of the slot if copy is set
+static void pkt_to_msg(struct tpacket2_hdr *hdr, int idx, int copy) {
+  FGFDM_LSNR_MSG_T *m = &msg_buf[idx];
+  struct msghdr *mh = &msg_hdr[idx].msg_hdr;
+  struct cmsghdr *cmsg;
+  struct timespec stamp;
+  const uint8_t *pkt, *ip, *udp;
+  unsigned int caplen, ihl, len, avail, done, k, part;
+
+  pkt = (const uint8_t *) hdr + hdr->tp_mac;
+  caplen = hdr->tp_snaplen;
+
+  // the filter guarantees IPv4/UDP, only the lengths are checked
+  len = 0;
+  avail = 0;
+  ip = pkt + ETH_HLEN;
+  ihl = (ip[0] & 0x0f) * 4;
+  udp = ip + ihl;
+  if (caplen >= ETH_HLEN + ihl + 8) {
+    len = (udp[4] << 8) | udp[5];
+    len = (len >= 8) ? len - 8 : 0;
+    avail = caplen - (ETH_HLEN + ihl + 8);
+  }
+
+  m->from.sin_family = AF_INET;
+  memcpy(&m->from.sin_addr, ip + 12, sizeof(m->from.sin_addr));
+
+  mh->msg_flags = 0;
+  if (len > avail) {
+    len = avail;
+    mh->msg_flags |= MSG_TRUNC;
+  }
+
+  // scatter like the socket layer does
+  for (k = 0, done = 0; k < mh->msg_iovlen && done < len; k++) {
+    part = len - done;
+    if (part > m->iov[k].iov_len) {
+      part = m->iov[k].iov_len;
+    }
+    if (copy) {
+      memcpy(m->iov[k].iov_base, udp + 8 + done, part);
+    }
+    done += part;
+  }
+  if (done < len) {
+    mh->msg_flags |= MSG_TRUNC;
+  }
+  msg_hdr[idx].msg_len = done;
+
+  // ring stamp as receive timestamp control message
+  mh->msg_controllen = CMSG_SPACE(sizeof(struct timespec));
+  cmsg = CMSG_FIRSTHDR(mh);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_TIMESTAMPNS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(struct timespec));
+  stamp.tv_sec = hdr->tp_sec;
+  stamp.tv_nsec = hdr->tp_nsec;
+  memcpy(CMSG_DATA(cmsg), &stamp, sizeof(stamp));
+}
+
+// receive loop on the packet ring, mirrors the socket loop: all
+// frames found at a wakeup are accounted, the newest one is published
+static void pkt_receive(int spin, int batch) {
+  struct tpacket2_hdr *frames[FGFDM_LSNR_BATCH];
+  struct tpacket2_hdr *hdr;
+  struct sockaddr_ll *sll;
+  struct pollfd pfd;
+  FGFDM_BUFFER_T *buffer;
+  long long now, last_rx, timeout;
+  int i, n, ret;
+
+  pfd.fd = pkt_fd;
+  pfd.events = POLLIN;
+  timeout = FGFDM_LISTENER_TIMEOUT * 1000000LL;
+  last_rx = fgfdm_get_time_ns();
+
+  buffer = fgfdm_shmem_write_begin(shmem, ring_mask);
+  init_msg_hdr(buffer);
+
+  warn_shown = 0;
+  while (!exit_req) {
+    // collect the frames handed over by the kernel
+    for (n = 0; n < batch; ) {
+      hdr = pkt_frame(pkt_next);
+      if (!(hdr->tp_status & TP_STATUS_USER)) {
+        break;
+      }
+      fgfdm_smp_rmb();
+      pkt_next++;
+
+      if (hdr->tp_status & TP_STATUS_LOSING) {
+        pkt_account_drops();
+      }
+
+      // own datagrams show up on the loopback interface too
+      sll = (struct sockaddr_ll *) ((uint8_t *) hdr + TPACKET_ALIGN(sizeof(struct tpacket2_hdr)));
+      if (sll->sll_pkttype == PACKET_OUTGOING) {
+        pkt_release(hdr);
+        continue;
+      }
+      frames[n++] = hdr;
+    }
+
+    if (n == 0) {
+      now = fgfdm_get_time_ns();
+      if (spin) {
+        if (now - last_rx > timeout) {
+          *(hal_data->data_valid) = 0;
+        }
+        update_rate(now);
+        continue;
+      }
+
+      ret = poll(&pfd, 1, FGFDM_LISTENER_TIMEOUT);
+      if (ret < 0 && errno != EINTR) {
+        fprintf(stderr, "%s: ERROR: unable to poll packet ring\n", modname);
+        break;
+      }
+      if (ret == 0) {
+        *(hal_data->data_valid) = 0;
+      }
+      update_rate(fgfdm_get_time_ns());
+      continue;
+    }
+    now = fgfdm_get_time_ns();
+    last_rx = now;
+
+    // only the newest payload is copied into the slot
+    for (i = 0; i < n; i++) {
+      pkt_to_msg(frames[i], i, i == n - 1);
+      pkt_release(frames[i]);
+    }
+
+    update_stats(n);
+    if (!check_source(n - 1)) {
+      init_msg_hdr(buffer);
+      update_rate(now);
+      continue;
+    }
+    if (rec_file != NULL) {
+      record_msg(buffer, n - 1);
+    }
+    if (publish_msg(buffer, n - 1) == 0) {
+      buffer = fgfdm_shmem_write_begin(shmem, ring_mask);
+    }
+    init_msg_hdr(buffer);
+    update_rate(now);
+  }
+}
+
+static int setup_sched(int prio, int cpu) {
+  struct sched_param sp;
+  cpu_set_t cpus;
+
+  if (cpu >= 0) {
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    if (sched_setaffinity(0, sizeof(cpus), &cpus)) {
+      fprintf(stderr, "%s: ERROR: unable to set cpu affinity to %d\n", modname, cpu);
+      return -1;
+    }
+  }
+
+  if (prio > 0) {
+    if (mlockall(MCL_CURRENT | MCL_FUTURE)) {
+      fprintf(stderr, "%s: WARNING: unable to lock memory\n", modname);
+    }
+    bzero(&sp, sizeof(sp));
+    sp.sched_priority = prio;
+    if (sched_setscheduler(0, SCHED_FIFO, &sp)) {
+      fprintf(stderr, "%s: ERROR: unable to set SCHED_FIFO priority %d\n", modname, prio);
+      return -1;
+    }
+  }
+
+  return 0;
+}
 
 static void exitHandler(int sig) {
+  exit_req = 1;
   if (lsnr_sock > 0) {
     close(lsnr_sock);
   }
@@ -32,14 +1011,157 @@ static void exitHandler(int sig) {
 int main(int argc, char **argv) {
   int ret = 1;
   struct sockaddr_in lsnr_addr;
-  FGFDM_SHMEM_T *shmem;
   struct timeval tv;
-  ssize_t n;
-  FGNetFDM msg;
-  long ts;
-  int warn_shown;
-  int wr_next;
+  int n, i;
+  int on;
+  int ring_depth = FGFDM_RING_DEPTH_DEFAULT;
+  int publish_all = 0;
+  int busy_poll = 0;
+  int spin = 0;
+  int prio = 0;
+  int cpu = -1;
+  const char *rec_name = NULL;
+  const char *generic_name = NULL;
+  const char *ifname = NULL;
+  const char *group = NULL;
+  const char *allow = NULL;
+  const char *pair = NULL;
+  const char *replay_name = NULL;
+  double replay_speed = 1.0;
+  int replay_loop = 0;
+  int flags, batch;
+  long long last_rx, timeout, now;
   FGFDM_BUFFER_T *buffer;
+  int instance = -1;
+  const char *name = NULL;
+  int opt;
+
+  // parse options
+  while ((opt = getopt(argc, argv, "i:n:d:ab:sp:c:t:r:R:x:lg:I:m:A:H:F:")) != -1) {
+    switch (opt) {
+      case 'i':
+        instance = atoi(optarg);
+        if (instance < 0) {
+          usage();
+          goto fail0;
+        }
+        break;
+      case 'n':
+        name = optarg;
+        break;
+      case 'd':
+        ring_depth = atoi(optarg);
+        break;
+      case 'a':
+        publish_all = 1;
+        break;
+      case 'b':
+        busy_poll = atoi(optarg);
+        break;
+      case 's':
+        spin = 1;
+        break;
+      case 'p':
+        prio = atoi(optarg);
+        break;
+      case 'c':
+        cpu = atoi(optarg);
+        break;
+      case 't':
+        dump_interval = atoi(optarg) * 1000000000LL;
+        break;
+      case 'r':
+        rec_name = optarg;
+        break;
+      case 'R':
+        replay_name = optarg;
+        break;
+      case 'x':
+        replay_speed = atof(optarg);
+        break;
+      case 'l':
+        replay_loop = 1;
+        break;
+      case 'g':
+        generic_name = optarg;
+        break;
+      case 'I':
+        ifname = optarg;
+        break;
+      case 'm':
+        group = optarg;
+        break;
+      case 'A':
+        allow = optarg;
+        break;
+      case 'H':
+        pair = optarg;
+        break;
+      case 'F':
+        failover_ns = atoi(optarg) * 1000000LL;
+        break;
+      default:
+        usage();
+        goto fail0;
+    }
+  }
+  if (!fgfdm_shmem_depth_valid(ring_depth)) {
+    fprintf(stderr, "%s: ERROR: invalid ring depth %d (must be a power of two between 2 and %d)\n", modname, ring_depth, FGFDM_RING_DEPTH_MAX);
+    goto fail0;
+  }
+  ring_mask = ring_depth - 1;
+  if (rec_name != NULL && replay_name != NULL) {
+    fprintf(stderr, "%s: ERROR: -r and -R are mutually exclusive\n", modname);
+    goto fail0;
+  }
+  if (ifname != NULL && replay_name != NULL) {
+    fprintf(stderr, "%s: ERROR: -I and -R are mutually exclusive\n", modname);
+    goto fail0;
+  }
+
+  // source selection
+  if (allow != NULL && pair != NULL) {
+    fprintf(stderr, "%s: ERROR: -A and -H are mutually exclusive\n", modname);
+    goto fail0;
+  }
+  if (allow != NULL && parse_sources(allow)) {
+    fprintf(stderr, "%s: ERROR: invalid source list %s (max. %d addresses)\n", modname, allow, FGFDM_LSNR_SOURCES_MAX);
+    goto fail0;
+  }
+  if (pair != NULL) {
+    if (parse_sources(pair) || source_count != 2) {
+      fprintf(stderr, "%s: ERROR: -H needs a primary and a standby address\n", modname);
+      goto fail0;
+    }
+    redundant = 1;
+  }
+  if ((source_count > 0 || group != NULL) && replay_name != NULL) {
+    fprintf(stderr, "%s: ERROR: -m, -A and -H can not be combined with -R\n", modname);
+    goto fail0;
+  }
+
+  // compile generic protocol layout
+  if (generic_name != NULL) {
+    if (rec_name != NULL || replay_name != NULL) {
+      fprintf(stderr, "%s: ERROR: -g can not be combined with -r or -R\n", modname);
+      goto fail0;
+    }
+    if (fgfdm_generic_load(modname, generic_name, &gen_layout)) {
+      goto fail0;
+    }
+    generic = 1;
+  }
+
+  // without instance argument the plain names of a single feed are used
+  if (instance >= 0) {
+    snprintf(modname, sizeof(modname), "%s_lsnr.%d", FGFDM_MODULE_NAME, instance);
+    snprintf(prefix, sizeof(prefix), "%s.%d", FGFDM_MODULE_NAME, instance);
+  } else {
+    instance = 0;
+  }
+  if (name != NULL) {
+    snprintf(prefix, sizeof(prefix), "%s", name);
+  }
 
   // initialize component
   hal_comp_id = hal_init(modname);
@@ -56,40 +1178,117 @@ int main(int argc, char **argv) {
   }
 
   // register pins
-  if (hal_pin_bit_newf(HAL_OUT, &(hal_data->data_valid), hal_comp_id, "%s.lsnr.data-valid", FGFDM_MODULE_NAME) != 0) {
-    fprintf(stderr, "%s: ERROR: unable to register pin %s.lsnr.data-valid\n", modname, FGFDM_MODULE_NAME);
+  if (hal_pin_bit_newf(HAL_OUT, &(hal_data->data_valid), hal_comp_id, "%s.lsnr.data-valid", prefix) != 0) {
+    fprintf(stderr, "%s: ERROR: unable to register pin %s.lsnr.data-valid\n", modname, prefix);
     goto fail1;
   }
   *(hal_data->data_valid) = 0;
 
-  if (hal_pin_u32_newf(HAL_OUT, &(hal_data->timestamp), hal_comp_id, "%s.lsnr.timestamp", FGFDM_MODULE_NAME) != 0) {
-    fprintf(stderr, "%s: ERROR: unable to register pin %s.lsnr.timestamp\n", modname, FGFDM_MODULE_NAME);
+  if (hal_pin_u32_newf(HAL_OUT, &(hal_data->timestamp), hal_comp_id, "%s.lsnr.timestamp", prefix) != 0) {
+    fprintf(stderr, "%s: ERROR: unable to register pin %s.lsnr.timestamp\n", modname, prefix);
     goto fail1;
   }
   *(hal_data->timestamp) = 0;
 
-  if (hal_pin_u32_newf(HAL_OUT, &(hal_data->msgno), hal_comp_id, "%s.lsnr.msgno", FGFDM_MODULE_NAME) != 0) {
-    fprintf(stderr, "%s: ERROR: unable to register pin %s.lsnr.msgno\n", modname, FGFDM_MODULE_NAME);
+  if (hal_pin_u32_newf(HAL_OUT, &(hal_data->msgno), hal_comp_id, "%s.lsnr.msgno", prefix) != 0) {
+    fprintf(stderr, "%s: ERROR: unable to register pin %s.lsnr.msgno\n", modname, prefix);
     goto fail1;
   }
   *(hal_data->msgno) = 0;
 
+  if (hal_pin_u32_newf(HAL_OUT, &(hal_data->rx_packets), hal_comp_id, "%s.lsnr.rx-packets", prefix) != 0) {
+    fprintf(stderr, "%s: ERROR: unable to register pin %s.lsnr.rx-packets\n", modname, prefix);
+    goto fail1;
+  }
+  *(hal_data->rx_packets) = 0;
+
+  if (hal_pin_u32_newf(HAL_OUT, &(hal_data->rx_malformed), hal_comp_id, "%s.lsnr.rx-malformed", prefix) != 0) {
+    fprintf(stderr, "%s: ERROR: unable to register pin %s.lsnr.rx-malformed\n", modname, prefix);
+    goto fail1;
+  }
+  *(hal_data->rx_malformed) = 0;
+
+  if (hal_pin_u32_newf(HAL_OUT, &(hal_data->rx_bad_version), hal_comp_id, "%s.lsnr.rx-bad-version", prefix) != 0) {
+    fprintf(stderr, "%s: ERROR: unable to register pin %s.lsnr.rx-bad-version\n", modname, prefix);
+    goto fail1;
+  }
+  *(hal_data->rx_bad_version) = 0;
+
+  if (hal_pin_u32_newf(HAL_OUT, &(hal_data->rx_overflow), hal_comp_id, "%s.lsnr.rx-overflow", prefix) != 0) {
+    fprintf(stderr, "%s: ERROR: unable to register pin %s.lsnr.rx-overflow\n", modname, prefix);
+    goto fail1;
+  }
+  *(hal_data->rx_overflow) = 0;
+
+  if (hal_pin_u32_newf(HAL_OUT, &(hal_data->rx_coalesced), hal_comp_id, "%s.lsnr.rx-coalesced", prefix) != 0) {
+    fprintf(stderr, "%s: ERROR: unable to register pin %s.lsnr.rx-coalesced\n", modname, prefix);
+    goto fail1;
+  }
+  *(hal_data->rx_coalesced) = 0;
+
+  if (hal_pin_u32_newf(HAL_OUT, &(hal_data->rx_ring_full), hal_comp_id, "%s.lsnr.rx-ring-full", prefix) != 0) {
+    fprintf(stderr, "%s: ERROR: unable to register pin %s.lsnr.rx-ring-full\n", modname, prefix);
+    goto fail1;
+  }
+  *(hal_data->rx_ring_full) = 0;
+
+  if (hal_pin_u32_newf(HAL_OUT, &(hal_data->rx_rejected), hal_comp_id, "%s.lsnr.rx-rejected", prefix) != 0) {
+    fprintf(stderr, "%s: ERROR: unable to register pin %s.lsnr.rx-rejected\n", modname, prefix);
+    goto fail1;
+  }
+  *(hal_data->rx_rejected) = 0;
+
+  if (hal_pin_s32_newf(HAL_OUT, &(hal_data->active_source), hal_comp_id, "%s.lsnr.active-source", prefix) != 0) {
+    fprintf(stderr, "%s: ERROR: unable to register pin %s.lsnr.active-source\n", modname, prefix);
+    goto fail1;
+  }
+  *(hal_data->active_source) = 0;
+
+  if (hal_pin_u32_newf(HAL_OUT, &(hal_data->failovers), hal_comp_id, "%s.lsnr.failovers", prefix) != 0) {
+    fprintf(stderr, "%s: ERROR: unable to register pin %s.lsnr.failovers\n", modname, prefix);
+    goto fail1;
+  }
+  *(hal_data->failovers) = 0;
+
+  if (hal_pin_float_newf(HAL_OUT, &(hal_data->packet_rate), hal_comp_id, "%s.lsnr.packet-rate", prefix) != 0) {
+    fprintf(stderr, "%s: ERROR: unable to register pin %s.lsnr.packet-rate\n", modname, prefix);
+    goto fail1;
+  }
+  *(hal_data->packet_rate) = 0.0;
+
+  if (hal_pin_float_newf(HAL_OUT, &(hal_data->interval_us), hal_comp_id, "%s.lsnr.interval-us", prefix) != 0) {
+    fprintf(stderr, "%s: ERROR: unable to register pin %s.lsnr.interval-us\n", modname, prefix);
+    goto fail1;
+  }
+  *(hal_data->interval_us) = 0.0;
+
+  if (hal_pin_float_newf(HAL_OUT, &(hal_data->jitter_us), hal_comp_id, "%s.lsnr.jitter-us", prefix) != 0) {
+    fprintf(stderr, "%s: ERROR: unable to register pin %s.lsnr.jitter-us\n", modname, prefix);
+    goto fail1;
+  }
+  *(hal_data->jitter_us) = 0.0;
+
+  for (i = 0; i < FGFDM_LSNR_JITTER_BUCKETS; i++) {
+    if (hal_pin_u32_newf(HAL_OUT, &(hal_data->jitter_hist[i]), hal_comp_id, "%s.lsnr.jitter-hist-%02d", prefix, i) != 0) {
+      fprintf(stderr, "%s: ERROR: unable to register pin %s.lsnr.jitter-hist-%02d\n", modname, prefix, i);
+      goto fail1;
+    }
+    *(hal_data->jitter_hist[i]) = 0;
+  }
+
   // initialize signal handling
   signal(SIGINT, exitHandler);
   signal(SIGTERM, exitHandler);
 
   // get port number
-  if (argc != 2) {
+  if (optind != argc - (replay_name == NULL)) {
     fprintf(stderr, "%s: ERROR: invalid arguments\n", modname);
+    usage();
     goto fail1;
   }
-  bzero(&lsnr_addr, sizeof(lsnr_addr));
-  lsnr_addr.sin_family = AF_INET;
-  lsnr_addr.sin_addr.s_addr = htonl(INADDR_ANY);
-  lsnr_addr.sin_port = htons(atoi(argv[1]));
 
-  // setup shared mem for double buffer
-  shmem_id = rtapi_shmem_new(FGFDM_SHMEM_KEY, hal_comp_id, sizeof(FGFDM_SHMEM_T));
+  // setup shared mem for frame ring
+  shmem_id = rtapi_shmem_new(FGFDM_SHMEM_KEY + instance, hal_comp_id, fgfdm_shmem_size(ring_depth));
   if ( shmem_id < 0 ) {
     fprintf(stderr, "%s: ERROR: couldn't allocate user/RT shared memory\n", modname);
     goto fail1;
@@ -98,7 +1297,29 @@ int main(int argc, char **argv) {
     fprintf(stderr, "%s: ERROR: couldn't map user/RT shared memory\n", modname);
     goto fail3;
   }
-  bzero(shmem, sizeof(FGFDM_SHMEM_T));
+  bzero(shmem, fgfdm_shmem_size(ring_depth));
+  shmem->depth = ring_depth;
+  memcpy(&shmem->layout, &gen_layout, sizeof(FGFDM_GENERIC_LAYOUT_T));
+
+  // setup decoder
+  ntohfdm_init();
+  stats.rate_start = fgfdm_get_time_ns();
+  stats.next_dump = stats.rate_start + dump_interval;
+
+  // replay a recording instead of listening
+  if (replay_name != NULL) {
+    if (setup_sched(prio, cpu)) {
+      goto fail3;
+    }
+    hal_ready(hal_comp_id);
+    ret = replay(replay_name, replay_speed, replay_loop) ? 1 : 0;
+    goto fail3;
+  }
+
+  bzero(&lsnr_addr, sizeof(lsnr_addr));
+  lsnr_addr.sin_family = AF_INET;
+  lsnr_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  lsnr_addr.sin_port = htons(atoi(argv[optind]));
 
   // create socket
   lsnr_sock = socket(AF_INET, SOCK_DGRAM, 0);
@@ -115,30 +1336,96 @@ int main(int argc, char **argv) {
     goto fail4;
   }
 
+  // enable kernel receive timestamps
+  on = 1;
+  if (setsockopt(lsnr_sock, SOL_SOCKET, SO_TIMESTAMPNS, (void *) &on, sizeof(on))) {
+    fprintf(stderr, "%s: WARNING: unable to enable kernel receive timestamps\n", modname);
+  }
+
+  // enable socket drop counter
+  on = 1;
+  if (setsockopt(lsnr_sock, SOL_SOCKET, SO_RXQ_OVFL, (void *) &on, sizeof(on))) {
+    fprintf(stderr, "%s: WARNING: unable to enable socket drop counter\n", modname);
+  }
+
+  // enable busy polling
+  if (busy_poll > 0) {
+    if (setsockopt(lsnr_sock, SOL_SOCKET, SO_BUSY_POLL, (void *) &busy_poll, sizeof(busy_poll))) {
+      fprintf(stderr, "%s: ERROR: unable to set busy poll time\n", modname);
+      goto fail4;
+    }
+  }
+
   // bind to udp port
   if (bind(lsnr_sock, (struct sockaddr *)&lsnr_addr, sizeof(lsnr_addr))) {
     fprintf(stderr, "%s: ERROR: unable bind listening socket\n", modname);
     goto fail4;
   }
 
+  // membership is kept by the socket, also for the packet ring
+  if (group != NULL && join_group(group, ifname)) {
+    goto fail4;
+  }
+
+  // datagrams of a batch share one slot, so check sources one by one
+  if (source_count > 0) {
+    publish_all = 1;
+  }
+
+  // datagrams of a batch share one slot, so record them one by one
+  if (rec_name != NULL) {
+    if (open_recording(rec_name)) {
+      goto fail4;
+    }
+    publish_all = 1;
+  }
+
+  // receive from a packet ring instead of the socket
+  if (ifname != NULL && open_pkt_ring(ifname, ntohs(lsnr_addr.sin_port))) {
+    goto fail5;
+  }
+
+  // setup scheduling
+  if (setup_sched(prio, cpu)) {
+    goto fail5;
+  }
+
   // everything is fine
   ret = 0;
   hal_ready(hal_comp_id);
 
+  // block until the first datagram arrived, then fetch all queued ones
+  flags = spin ? MSG_DONTWAIT : MSG_WAITFORONE;
+  batch = publish_all ? 1 : FGFDM_LSNR_BATCH;
+
+  if (ifname != NULL) {
+    pkt_receive(spin, batch);
+    goto fail5;
+  }
+  timeout = FGFDM_LISTENER_TIMEOUT * 1000000LL;
+  last_rx = fgfdm_get_time_ns();
+
+  // reserve the slot for the next frame
+  buffer = fgfdm_shmem_write_begin(shmem, ring_mask);
+  init_msg_hdr(buffer);
+
   warn_shown = 0;
-  for (;;) {
+  while (!exit_req) {
     // read data from flightgear
-    n = recv(lsnr_sock, &msg, sizeof(FGNetFDM), 0);
-    ts = fgfdm_get_ticks();
+    n = recvmmsg(lsnr_sock, msg_hdr, batch, flags, NULL);
     if (n < 0) {
       // kill
-      if (errno == EINTR) {
+      if (errno == EINTR || exit_req) {
         break;
       }
 
       // timeout
       if (errno == EAGAIN) {
-        *(hal_data->data_valid) = 0;
+        now = fgfdm_get_time_ns();
+        if (!spin || now - last_rx > timeout) {
+          *(hal_data->data_valid) = 0;
+        }
+        update_rate(now);
         continue;
       }
 
@@ -146,65 +1433,35 @@ int main(int argc, char **argv) {
       fprintf(stderr, "%s: ERROR: unable to read from socket\n", modname);
       break;
     }
-
-    // get next write buffer
-    wr_next = shmem->wr_pos + 1;
-    if (wr_next >= FGFDM_BUFFER_COUNT) {
-      wr_next = 0;
+    now = fgfdm_get_time_ns();
+    if (spin) {
+      last_rx = now;
     }
-    
-    // check for overflow
-    if (wr_next == shmem->rd_pos) {
-      if (!warn_shown) {
-        warn_shown = 1;
-        fprintf(stderr, "%s: WARNING: fifo overflow\n", modname);
-      }
-      continue;
-    }
-
-    // set timestamp
-    buffer = &shmem->buffer[wr_next];
-    buffer->data_valid = 0;
-    buffer->timestamp = ts;
-    buffer->msgno = *(hal_data->msgno);
 
-    // check data size
-    if (n != sizeof(FGNetFDM)) {
-      shmem->wr_pos = wr_next;
-      *(hal_data->data_valid) = 0;
-      if (!warn_shown) {
-        warn_shown = 1;
-        fprintf(stderr, "%s: WARNING: invalid data length (is: %ld sould be: %ld)\n", modname, n, sizeof(FGNetFDM));
-      }
+    // publish newest datagram and reserve the next slot, the slot
+    // is reused if the source is not accepted or the ring is full
+    update_stats(n);
+    if (!check_source(n - 1)) {
+      init_msg_hdr(buffer);
+      update_rate(now);
       continue;
     }
-
-    // convert to host byte order
-    ntohfdm(&msg);
-
-    // check version
-    if (msg.version != FG_NET_FDM_VERSION) {
-      shmem->wr_pos = wr_next;
-      *(hal_data->data_valid) = 0;
-      if (!warn_shown) {
-        warn_shown = 1;
-        fprintf(stderr, "%s: WARNING: invalid data version (is: %u sould be: %u)\n", modname, msg.version, FG_NET_FDM_VERSION);
-      }
-      continue;
+    if (rec_file != NULL) {
+      record_msg(buffer, n - 1);
     }
-
-    // now data is valid
-    memcpy(&buffer->data, &msg, sizeof(FGNetFDM));
-    buffer->data_valid = 1;
-    shmem->wr_pos = wr_next;
-    warn_shown = 0;
-
-    // update status pins
-    *(hal_data->data_valid) = 1;
-    *(hal_data->timestamp) = ts;
-    (*(hal_data->msgno))++;
+    if (publish_msg(buffer, n - 1) == 0) {
+      buffer = fgfdm_shmem_write_begin(shmem, ring_mask);
+    }
+    init_msg_hdr(buffer);
+    update_rate(now);
   }
 
+fail5:
+  close_pkt_ring();
+  if (rec_file != NULL) {
+    fclose(rec_file);
+    fprintf(stderr, "%s: recorded %lu datagrams\n", modname, rec_count);
+  }
 fail4:
   close(lsnr_sock);
 fail3:
@@ -0,0 +1,120 @@
+#ifndef _FGFDM_PROF_H
+#define _FGFDM_PROF_H
+
+#include "rtapi.h"
+#include "hal.h"
+
+#define FGFDM_PROF_BUCKETS 24
+
+typedef struct {
+  // execution time in cpu clocks
+  hal_bit_t *reset;
+  hal_u32_t *count;
+  hal_u32_t *min;
+  hal_u32_t *max;
+  hal_u32_t *mean;
+  hal_u32_t *hist[FGFDM_PROF_BUCKETS];
+
+  double sum;
+} FGFDM_PROF_T;
+
+// export the <name>.prof-* pins, returns NULL on error
+static inline FGFDM_PROF_T *fgfdm_prof_export(int comp_id, const char *name) {
+  FGFDM_PROF_T *prof;
+  int i;
+
+  if ((prof = hal_malloc(sizeof(FGFDM_PROF_T))) == NULL) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "%s: hal_malloc() failed\n", name);
+    return NULL;
+  }
+
+  if (hal_pin_bit_newf(HAL_IN, &(prof->reset), comp_id, "%s.prof-reset", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "%s: exporting pin %s.prof-reset failed\n", name, name);
+    return NULL;
+  }
+  *(prof->reset) = 0;
+
+  if (hal_pin_u32_newf(HAL_OUT, &(prof->count), comp_id, "%s.prof-count", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "%s: exporting pin %s.prof-count failed\n", name, name);
+    return NULL;
+  }
+  *(prof->count) = 0;
+
+  if (hal_pin_u32_newf(HAL_OUT, &(prof->min), comp_id, "%s.prof-min", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "%s: exporting pin %s.prof-min failed\n", name, name);
+    return NULL;
+  }
+  *(prof->min) = 0;
+
+  if (hal_pin_u32_newf(HAL_OUT, &(prof->max), comp_id, "%s.prof-max", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "%s: exporting pin %s.prof-max failed\n", name, name);
+    return NULL;
+  }
+  *(prof->max) = 0;
+
+  if (hal_pin_u32_newf(HAL_OUT, &(prof->mean), comp_id, "%s.prof-mean", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "%s: exporting pin %s.prof-mean failed\n", name, name);
+    return NULL;
+  }
+  *(prof->mean) = 0;
+
+  for (i = 0; i < FGFDM_PROF_BUCKETS; i++) {
+    if (hal_pin_u32_newf(HAL_OUT, &(prof->hist[i]), comp_id, "%s.prof-hist-%02d", name, i)) {
+      rtapi_print_msg(RTAPI_MSG_ERR, "%s: exporting pin %s.prof-hist-%02d failed\n", name, name, i);
+      return NULL;
+    }
+    *(prof->hist[i]) = 0;
+  }
+
+  prof->sum = 0.0;
+  return prof;
+}
+
+// start a measurement, no clock read if profiling is disabled (prof == NULL)
+static inline long long fgfdm_prof_start(FGFDM_PROF_T *prof) {
+  return (prof != NULL) ? rtapi_get_clocks() : 0;
+}
+
+// end a measurement and update the statistics
+static inline void fgfdm_prof_end(FGFDM_PROF_T *prof, long long start) {
+  long long clocks;
+  uint32_t t;
+  int i;
+
+  if (prof == NULL) {
+    return;
+  }
+
+  if (*(prof->reset)) {
+    *(prof->count) = 0;
+    *(prof->min) = 0;
+    *(prof->max) = 0;
+    *(prof->mean) = 0;
+    for (i = 0; i < FGFDM_PROF_BUCKETS; i++) {
+      *(prof->hist[i]) = 0;
+    }
+    prof->sum = 0.0;
+    return;
+  }
+
+  clocks = rtapi_get_clocks() - start;
+  t = (clocks < 0) ? 0 : ((clocks > 0xffffffffLL) ? 0xffffffff : (uint32_t) clocks);
+  if (*(prof->count) == 0 || t < *(prof->min)) {
+    *(prof->min) = t;
+  }
+  if (t > *(prof->max)) {
+    *(prof->max) = t;
+  }
+  prof->sum += t;
+  (*(prof->count))++;
+  *(prof->mean) = prof->sum / *(prof->count);
+
+  // log2 histogram, last bucket collects everything above
+  i = (t == 0) ? 0 : 31 - __builtin_clz(t);
+  if (i >= FGFDM_PROF_BUCKETS) {
+    i = FGFDM_PROF_BUCKETS - 1;
+  }
+  (*(prof->hist[i]))++;
+}
+
+#endif
@@ -1,19 +1,78 @@
+// recvmmsg() for the uspace direct mode
+#if !defined(__KERNEL__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
 #include "fgfdm.h"
+#include "fgfdm_prof.h"
 
 #include "rtapi_app.h"
 #include "rtapi_math.h"
 
+#ifndef __KERNEL__
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#endif
+
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Sascha Ittner <sascha.ittner@modusoft.de>");
 MODULE_DESCRIPTION("FlightGear NetFDM to HAL interface");
 
-#define RAD2DEG(a) (a * (180.0 / M_PI))
+#define FGFDM_MAX_INSTANCES 8
+
+static int count = 0;
+RTAPI_MP_INT(count, "number of FlightGear feeds");
+static char *names[FGFDM_MAX_INSTANCES] = {0,};
+RTAPI_MP_ARRAY_STRING(names, FGFDM_MAX_INSTANCES, "names of FlightGear feeds");
+
+static int ring_depth = FGFDM_RING_DEPTH_DEFAULT;
+RTAPI_MP_INT(ring_depth, "number of shmem ring slots (power of two, must match fgfdm_lsnr -d)");
+static char *read_mode = "latest";
+RTAPI_MP_STRING(read_mode, "frame read mode: latest, fifo or drain");
+static char *groups = "all";
+RTAPI_MP_STRING(groups, "pin groups to export: all or a list of pos,velo,accel,stall,engine,cons,gear,env,ctrl");
+static int extrapolate_ms = 0;
+RTAPI_MP_INT(extrapolate_ms, "maximum dead-reckoning horizon of the pos group in ms (0 disables extrapolation)");
+static int profile = 0;
+RTAPI_MP_INT(profile, "export execution time statistics of fgfdm.read (1 = enabled)");
+static int trace_depth = 0;
+RTAPI_MP_INT(trace_depth, "number of latency trace ring records (power of two, 0 disables tracing)");
+static int send_values = 0;
+RTAPI_MP_INT(send_values, "number of fgfdm.send.value-NN pins sent to FlightGear by fgfdm_sndr (0 disables fgfdm.write)");
+static int ports[FGFDM_MAX_INSTANCES] = {0,};
+RTAPI_MP_ARRAY_INT(ports, FGFDM_MAX_INSTANCES, "UDP ports received directly by fgfdm.read instead of fgfdm_lsnr (uspace only, 0 = listener)");
+
+#define RAD2DEG(a) ((a) * (180.0 / M_PI))
+
+#define FT2M 0.3048
+#define EARTH_RADIUS_M 6378137.0
+
+// max. number of datagrams fetched per fgfdm.read in direct mode
+#define FGFDM_DIRECT_BATCH 16
+
+#define FGFDM_READ_LATEST 0
+#define FGFDM_READ_FIFO   1
+#define FGFDM_READ_DRAIN  2
+
+typedef union {
+    hal_bit_t *b;
+    hal_s32_t *s;
+    hal_float_t *f;
+} FGFDM_GENERIC_PIN_T;
 
 typedef struct {
     // statistic data
     hal_bit_t *data_valid;
     hal_u32_t *timestamp;
     hal_u32_t *msgno;
+    hal_u32_t *data_age_ns;
+    hal_bit_t *new_frame;
+    hal_u32_t *frame_period_ns;
+    hal_u32_t *torn_reads;
+    hal_u32_t *overwritten;
+    hal_u32_t *frames_drained;
+    hal_u32_t *extrapolated_ns;
 
     // Positions
     hal_float_t *longitude;
@@ -91,523 +150,1417 @@ typedef struct {
     hal_float_t *speedbrake;
     hal_float_t *spoilers;
 
+    // Generic protocol
+    FGFDM_GENERIC_PIN_T generic[FGFDM_GENERIC_MAX_FIELDS];
+
     long long timeout;
+    uint32_t tail;
+    uint32_t last_frame;
+    long long last_rx_time;
+    double dr_lon_scale;
 } FGFDM_HAL_T;
 
-static int comp_id = -1;
-static int shmem_id = -1;
-static FGFDM_SHMEM_T *shmem;
-static FGFDM_HAL_T *hal_data;
-
-void fgfdm_read(void *arg, long period) {
-  FGFDM_BUFFER_T *buffer;
-  FGNetFDM *data;
-  int i, rd_pos;
-
-  // check if data available
-  rd_pos = shmem->rd_pos;
-  if (rd_pos == shmem->wr_pos) {
-    if (hal_data->timeout > 0) {
-      hal_data->timeout -= period;
-    } else {
-      *(hal_data->data_valid) = 0;
-    }
-    return;
-  }
-
-  // get current read buffer
-  buffer = &shmem->buffer[rd_pos];
-
-  // set statistics data
-  hal_data->timeout = FGFDM_LISTENER_TIMEOUT * 1000000LL;
-  *(hal_data->data_valid) = buffer->data_valid;
-  *(hal_data->timestamp) = buffer->timestamp;
-  *(hal_data->msgno) = buffer->msgno;
-
-  // update flightgear data
-  data = &buffer->data;
-
-  *(hal_data->longitude) = RAD2DEG(data->longitude);
-  *(hal_data->latitude) = RAD2DEG(data->latitude);
-  *(hal_data->altitude) = data->altitude;
-  *(hal_data->agl) = data->agl;
-  *(hal_data->phi) = RAD2DEG(data->phi);
-  *(hal_data->theta) = RAD2DEG(data->theta);
-  *(hal_data->psi) = RAD2DEG(data->psi);
-  *(hal_data->alpha) = RAD2DEG(data->alpha);
-  *(hal_data->beta) = RAD2DEG(data->beta);
-
-  *(hal_data->phidot) = RAD2DEG(data->phidot);
-  *(hal_data->thetadot) = RAD2DEG(data->thetadot);
-  *(hal_data->psidot) = RAD2DEG(data->psidot);
-  *(hal_data->vcas) = data->vcas;
-  *(hal_data->climb_rate) = data->climb_rate;
-  *(hal_data->v_north) = data->v_north;
-  *(hal_data->v_east) = data->v_east;
-  *(hal_data->v_down) = data->v_down;
-  *(hal_data->v_body_u) = data->v_body_u;
-  *(hal_data->v_body_v) = data->v_body_v;
-  *(hal_data->v_body_w) = data->v_body_w;
-
-  *(hal_data->A_X_pilot) = data->A_X_pilot;
-  *(hal_data->A_Y_pilot) = data->A_Y_pilot;
-  *(hal_data->A_Z_pilot) = data->A_Z_pilot;
-
-  *(hal_data->stall_warning) = data->stall_warning;
-  *(hal_data->slip_deg) = data->slip_deg;
-
-  *(hal_data->num_engines) = data->num_engines;
-  for (i=0; i<FG_MAX_ENGINES; i++) {
-    *(hal_data->eng_state[i]) = data->eng_state[i];
-    *(hal_data->rpm[i]) = data->rpm[i];
-    *(hal_data->fuel_flow[i]) = data->fuel_flow[i];
-    *(hal_data->fuel_px[i]) = data->fuel_px[i];
-    *(hal_data->egt[i]) = data->egt[i];
-    *(hal_data->cht[i]) = data->cht[i];
-    *(hal_data->mp_osi[i]) = data->mp_osi[i];
-    *(hal_data->tit[i]) = data->tit[i];
-    *(hal_data->oil_temp[i]) = data->oil_temp[i];
-    *(hal_data->oil_px[i]) = data->oil_px[i];
-  }
-
-  *(hal_data->num_tanks) = data->num_tanks;
-  for (i=0; i<FG_MAX_TANKS; i++) {
-    *(hal_data->fuel_quantity[i]) = data->fuel_quantity[i];
-  }
-
-  *(hal_data->num_wheels) = data->num_wheels;
-  for (i=0; i<FG_MAX_WHEELS; i++) {
-    *(hal_data->wow[i]) = data->wow[i];
-    *(hal_data->gear_pos[i]) = data->gear_pos[i];
-    *(hal_data->gear_steer[i]) = data->gear_steer[i];
-    *(hal_data->gear_compression[i]) = data->gear_compression[i];
-  }
+typedef struct {
+  hal_float_t *value[FGFDM_SNDR_MAX_VALUES];
+} FGFDM_SEND_HAL_T;
 
-  *(hal_data->cur_time) = data->cur_time;
-  *(hal_data->warp) = data->warp;
-  *(hal_data->visibility) = data->visibility;
-  *(hal_data->elevator) = data->elevator;
-  *(hal_data->elevator_trim_tab) = data->elevator_trim_tab;
-  *(hal_data->left_flap) = data->left_flap;
-  *(hal_data->right_flap) = data->right_flap;
-  *(hal_data->left_aileron) = data->left_aileron;
-  *(hal_data->right_aileron) = data->right_aileron;
-  *(hal_data->rudder) = data->rudder;
-  *(hal_data->nose_wheel) = data->nose_wheel;
-  *(hal_data->speedbrake) = data->speedbrake;
-  *(hal_data->spoilers) = data->spoilers;
+typedef struct {
+  const char *name;
+  int (*export)(FGFDM_HAL_T *hal_data, const char *name);
+  void (*read)(FGFDM_HAL_T *hal_data, FGNetFDM *data);
+} FGFDM_GROUP_T;
 
-  // update read pointer
-  rd_pos++;
-  if (rd_pos >= FGFDM_BUFFER_COUNT) {
-    rd_pos = 0;
-  }
-  shmem->rd_pos = rd_pos;
-}
+typedef struct fgfdm_direct FGFDM_DIRECT_T;
 
-int rtapi_app_main(void) {
+typedef struct {
   char name[HAL_NAME_LEN + 1];
-  int i;
-
-  // connect to the HAL
-  if ((comp_id = hal_init (FGFDM_MODULE_NAME)) < 0) {
-    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: hal_init() failed\n");
-    goto fail0;
-  }
-
-  // open shmem segment
-  shmem_id = rtapi_shmem_new(FGFDM_SHMEM_KEY, comp_id, sizeof(FGFDM_SHMEM_T));
-  if (shmem_id < 0) {
-    rtapi_print_msg (RTAPI_MSG_ERR, "FGFDM: couldn't allocate user/RT shared memory\n");
-    goto fail1;
-  }
-  if (fgfdm_rtapi_shmem_getptr(shmem_id, (void **) &shmem) < 0 ) {
-    rtapi_print_msg (RTAPI_MSG_ERR, "FGFDM: couldn't map user/RT shared memory\n");
-    goto fail2;
-  }
-
-  // alloc hal memory
-  if ((hal_data = hal_malloc(sizeof(FGFDM_HAL_T))) == NULL) {
-    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: hal_malloc() failed\n");
-    goto fail2;
-  }
-
-  // export pins
-  if (hal_pin_bit_newf(HAL_OUT, &(hal_data->data_valid), comp_id, "%s.data-valid", FGFDM_MODULE_NAME)) {
-    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.data-valid failed\n", FGFDM_MODULE_NAME);
-    goto fail2;
-  }
-  *(hal_data->data_valid) = 0;
-
-  if (hal_pin_u32_newf(HAL_OUT, &(hal_data->timestamp), comp_id, "%s.timestamp", FGFDM_MODULE_NAME)) {
-    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.timestamp failed\n", FGFDM_MODULE_NAME);
-    goto fail2;
-  }
-  *(hal_data->timestamp) = 0;
+  int shmem_id;
+  FGFDM_SHMEM_T *shmem;
+  // socket received by fgfdm.read itself (private ring, no listener)
+  FGFDM_DIRECT_T *direct;
+  FGFDM_HAL_T *hal_data;
+  FGFDM_BUFFER_T rd_buffer[2];
+  int rd_index;
+  FGFDM_TRACE_REC_T trace_rec;
+  int trace_pending;
+  // generic protocol layout at load time
+  uint32_t gen_count;
+  uint32_t gen_hash;
+  uint16_t gen_type[FGFDM_GENERIC_MAX_FIELDS];
+  // layout mismatch already reported
+  int gen_mismatch;
+} FGFDM_INST_T;
 
-  if (hal_pin_u32_newf(HAL_OUT, &(hal_data->msgno), comp_id, "%s.msgno", FGFDM_MODULE_NAME)) {
-    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.msgno failed\n", FGFDM_MODULE_NAME);
-    goto fail2;
-  }
-  *(hal_data->msgno) = 0;
-
-  if (hal_pin_float_newf(HAL_OUT, &(hal_data->longitude), comp_id, "%s.pos.longitude", FGFDM_MODULE_NAME)) {
-    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.pos.longitude failed\n", FGFDM_MODULE_NAME);
-    goto fail2;
+static int comp_id = -1;
+static uint32_t ring_mask;
+static long long extrapolate_ns;
+static int read_mode_id;
+static unsigned int group_mask;
+static int inst_count;
+static FGFDM_INST_T *instances;
+static FGFDM_PROF_T *prof_data;
+static int trace_shmem_id = -1;
+static FGFDM_TRACE_T *trace;
+static int sndr_shmem_id = -1;
+static FGFDM_SNDR_SHMEM_T *sndr_shmem;
+static FGFDM_SEND_HAL_T *send_data;
+
+static int export_pos(FGFDM_HAL_T *hal_data, const char *name) {
+  if (hal_pin_float_newf(HAL_OUT, &(hal_data->longitude), comp_id, "%s.pos.longitude", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.pos.longitude failed\n", name);
+    return -1;
   }
   *(hal_data->longitude) = 0.0;
 
-  if (hal_pin_float_newf(HAL_OUT, &(hal_data->latitude), comp_id, "%s.pos.latitude", FGFDM_MODULE_NAME)) {
-    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.pos.latitude failed\n", FGFDM_MODULE_NAME);
-    goto fail2;
+  if (hal_pin_float_newf(HAL_OUT, &(hal_data->latitude), comp_id, "%s.pos.latitude", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.pos.latitude failed\n", name);
+    return -1;
   }
   *(hal_data->latitude) = 0.0;
 
-  if (hal_pin_float_newf(HAL_OUT, &(hal_data->altitude), comp_id, "%s.pos.altitude", FGFDM_MODULE_NAME)) {
-    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.pos.altitude failed\n", FGFDM_MODULE_NAME);
-    goto fail2;
+  if (hal_pin_float_newf(HAL_OUT, &(hal_data->altitude), comp_id, "%s.pos.altitude", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.pos.altitude failed\n", name);
+    return -1;
   }
   *(hal_data->altitude) = 0.0;
 
-  if (hal_pin_float_newf(HAL_OUT, &(hal_data->agl), comp_id, "%s.pos.agl", FGFDM_MODULE_NAME)) {
-    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.pos.agl failed\n", FGFDM_MODULE_NAME);
-    goto fail2;
+  if (hal_pin_float_newf(HAL_OUT, &(hal_data->agl), comp_id, "%s.pos.agl", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.pos.agl failed\n", name);
+    return -1;
   }
   *(hal_data->agl) = 0.0;
 
-  if (hal_pin_float_newf(HAL_OUT, &(hal_data->phi), comp_id, "%s.pos.phi", FGFDM_MODULE_NAME)) {
-    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.pos.phi failed\n", FGFDM_MODULE_NAME);
-    goto fail2;
+  if (hal_pin_float_newf(HAL_OUT, &(hal_data->phi), comp_id, "%s.pos.phi", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.pos.phi failed\n", name);
+    return -1;
   }
   *(hal_data->phi) = 0.0;
 
-  if (hal_pin_float_newf(HAL_OUT, &(hal_data->theta), comp_id, "%s.pos.theta", FGFDM_MODULE_NAME)) {
-    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.pos.theta failed\n", FGFDM_MODULE_NAME);
-    goto fail2;
+  if (hal_pin_float_newf(HAL_OUT, &(hal_data->theta), comp_id, "%s.pos.theta", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.pos.theta failed\n", name);
+    return -1;
   }
   *(hal_data->theta) = 0.0;
 
-  if (hal_pin_float_newf(HAL_OUT, &(hal_data->psi), comp_id, "%s.pos.psi", FGFDM_MODULE_NAME)) {
-    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.pos.psi failed\n", FGFDM_MODULE_NAME);
-    goto fail2;
+  if (hal_pin_float_newf(HAL_OUT, &(hal_data->psi), comp_id, "%s.pos.psi", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.pos.psi failed\n", name);
+    return -1;
   }
   *(hal_data->psi) = 0.0;
 
-  if (hal_pin_float_newf(HAL_OUT, &(hal_data->alpha), comp_id, "%s.pos.alpha", FGFDM_MODULE_NAME)) {
-    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.pos.alpha failed\n", FGFDM_MODULE_NAME);
-    goto fail2;
+  if (hal_pin_float_newf(HAL_OUT, &(hal_data->alpha), comp_id, "%s.pos.alpha", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.pos.alpha failed\n", name);
+    return -1;
   }
   *(hal_data->alpha) = 0.0;
 
-  if (hal_pin_float_newf(HAL_OUT, &(hal_data->beta), comp_id, "%s.pos.beta", FGFDM_MODULE_NAME)) {
-    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.pos.beta failed\n", FGFDM_MODULE_NAME);
-    goto fail2;
+  if (hal_pin_float_newf(HAL_OUT, &(hal_data->beta), comp_id, "%s.pos.beta", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.pos.beta failed\n", name);
+    return -1;
   }
   *(hal_data->beta) = 0.0;
 
-  if (hal_pin_float_newf(HAL_OUT, &(hal_data->phidot), comp_id, "%s.velo.phidot", FGFDM_MODULE_NAME)) {
-    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.velo.phidot failed\n", FGFDM_MODULE_NAME);
-    goto fail2;
+  return 0;
+}
+
+static int export_velo(FGFDM_HAL_T *hal_data, const char *name) {
+  if (hal_pin_float_newf(HAL_OUT, &(hal_data->phidot), comp_id, "%s.velo.phidot", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.velo.phidot failed\n", name);
+    return -1;
   }
   *(hal_data->phidot) = 0.0;
 
-  if (hal_pin_float_newf(HAL_OUT, &(hal_data->thetadot), comp_id, "%s.velo.thetadot", FGFDM_MODULE_NAME)) {
-    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.velo.thetadot failed\n", FGFDM_MODULE_NAME);
-    goto fail2;
+  if (hal_pin_float_newf(HAL_OUT, &(hal_data->thetadot), comp_id, "%s.velo.thetadot", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.velo.thetadot failed\n", name);
+    return -1;
   }
   *(hal_data->thetadot) = 0.0;
 
-  if (hal_pin_float_newf(HAL_OUT, &(hal_data->psidot), comp_id, "%s.velo.psidot", FGFDM_MODULE_NAME)) {
-    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.velo.psidot failed\n", FGFDM_MODULE_NAME);
-    goto fail2;
+  if (hal_pin_float_newf(HAL_OUT, &(hal_data->psidot), comp_id, "%s.velo.psidot", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.velo.psidot failed\n", name);
+    return -1;
   }
   *(hal_data->psidot) = 0.0;
 
-  if (hal_pin_float_newf(HAL_OUT, &(hal_data->vcas), comp_id, "%s.velo.vcas", FGFDM_MODULE_NAME)) {
-    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.velo.vcas failed\n", FGFDM_MODULE_NAME);
-    goto fail2;
+  if (hal_pin_float_newf(HAL_OUT, &(hal_data->vcas), comp_id, "%s.velo.vcas", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.velo.vcas failed\n", name);
+    return -1;
   }
   *(hal_data->vcas) = 0.0;
 
-  if (hal_pin_float_newf(HAL_OUT, &(hal_data->climb_rate), comp_id, "%s.velo.climb_rate", FGFDM_MODULE_NAME)) {
-    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.velo.climb_rate failed\n", FGFDM_MODULE_NAME);
-    goto fail2;
+  if (hal_pin_float_newf(HAL_OUT, &(hal_data->climb_rate), comp_id, "%s.velo.climb_rate", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.velo.climb_rate failed\n", name);
+    return -1;
   }
   *(hal_data->climb_rate) = 0.0;
 
-  if (hal_pin_float_newf(HAL_OUT, &(hal_data->v_north), comp_id, "%s.velo.v_north", FGFDM_MODULE_NAME)) {
-    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.velo.v_north failed\n", FGFDM_MODULE_NAME);
-    goto fail2;
+  if (hal_pin_float_newf(HAL_OUT, &(hal_data->v_north), comp_id, "%s.velo.v_north", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.velo.v_north failed\n", name);
+    return -1;
   }
   *(hal_data->v_north) = 0.0;
 
-  if (hal_pin_float_newf(HAL_OUT, &(hal_data->v_east), comp_id, "%s.velo.v_east", FGFDM_MODULE_NAME)) {
-    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.velo.v_east failed\n", FGFDM_MODULE_NAME);
-    goto fail2;
+  if (hal_pin_float_newf(HAL_OUT, &(hal_data->v_east), comp_id, "%s.velo.v_east", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.velo.v_east failed\n", name);
+    return -1;
   }
   *(hal_data->v_east) = 0.0;
 
-  if (hal_pin_float_newf(HAL_OUT, &(hal_data->v_down), comp_id, "%s.velo.v_down", FGFDM_MODULE_NAME)) {
-    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.velo.v_down failed\n", FGFDM_MODULE_NAME);
-    goto fail2;
+  if (hal_pin_float_newf(HAL_OUT, &(hal_data->v_down), comp_id, "%s.velo.v_down", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.velo.v_down failed\n", name);
+    return -1;
   }
   *(hal_data->v_down) = 0.0;
 
-  if (hal_pin_float_newf(HAL_OUT, &(hal_data->v_body_u), comp_id, "%s.velo.v_body_u", FGFDM_MODULE_NAME)) {
-    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.velo.v_body_u failed\n", FGFDM_MODULE_NAME);
-    goto fail2;
+  if (hal_pin_float_newf(HAL_OUT, &(hal_data->v_body_u), comp_id, "%s.velo.v_body_u", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.velo.v_body_u failed\n", name);
+    return -1;
   }
   *(hal_data->v_body_u) = 0.0;
 
-  if (hal_pin_float_newf(HAL_OUT, &(hal_data->v_body_v), comp_id, "%s.velo.v_body_v", FGFDM_MODULE_NAME)) {
-    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.velo.v_body_v failed\n", FGFDM_MODULE_NAME);
-    goto fail2;
+  if (hal_pin_float_newf(HAL_OUT, &(hal_data->v_body_v), comp_id, "%s.velo.v_body_v", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.velo.v_body_v failed\n", name);
+    return -1;
   }
   *(hal_data->v_body_v) = 0.0;
 
-  if (hal_pin_float_newf(HAL_OUT, &(hal_data->v_body_w), comp_id, "%s.velo.v_body_w", FGFDM_MODULE_NAME)) {
-    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.velo.v_body_w failed\n", FGFDM_MODULE_NAME);
-    goto fail2;
+  if (hal_pin_float_newf(HAL_OUT, &(hal_data->v_body_w), comp_id, "%s.velo.v_body_w", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.velo.v_body_w failed\n", name);
+    return -1;
   }
   *(hal_data->v_body_w) = 0.0;
 
-  if (hal_pin_float_newf(HAL_OUT, &(hal_data->A_X_pilot), comp_id, "%s.accel.A_X_pilot", FGFDM_MODULE_NAME)) {
-    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.accel.A_X_pilot failed\n", FGFDM_MODULE_NAME);
-    goto fail2;
+  return 0;
+}
+
+static int export_accel(FGFDM_HAL_T *hal_data, const char *name) {
+  if (hal_pin_float_newf(HAL_OUT, &(hal_data->A_X_pilot), comp_id, "%s.accel.A_X_pilot", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.accel.A_X_pilot failed\n", name);
+    return -1;
   }
   *(hal_data->A_X_pilot) = 0.0;
 
-  if (hal_pin_float_newf(HAL_OUT, &(hal_data->A_Y_pilot), comp_id, "%s.accel.A_Y_pilot", FGFDM_MODULE_NAME)) {
-    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.accel.A_Y_pilot failed\n", FGFDM_MODULE_NAME);
-    goto fail2;
+  if (hal_pin_float_newf(HAL_OUT, &(hal_data->A_Y_pilot), comp_id, "%s.accel.A_Y_pilot", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.accel.A_Y_pilot failed\n", name);
+    return -1;
   }
   *(hal_data->A_Y_pilot) = 0.0;
 
-  if (hal_pin_float_newf(HAL_OUT, &(hal_data->A_Z_pilot), comp_id, "%s.accel.A_Z_pilot", FGFDM_MODULE_NAME)) {
-    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.accel.A_Z_pilot failed\n", FGFDM_MODULE_NAME);
-    goto fail2;
+  if (hal_pin_float_newf(HAL_OUT, &(hal_data->A_Z_pilot), comp_id, "%s.accel.A_Z_pilot", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.accel.A_Z_pilot failed\n", name);
+    return -1;
   }
   *(hal_data->A_Z_pilot) = 0.0;
 
-  if (hal_pin_float_newf(HAL_OUT, &(hal_data->stall_warning), comp_id, "%s.stall.stall_warning", FGFDM_MODULE_NAME)) {
-    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.stall.stall_warning failed\n", FGFDM_MODULE_NAME);
-    goto fail2;
+  return 0;
+}
+
+static int export_stall(FGFDM_HAL_T *hal_data, const char *name) {
+  if (hal_pin_float_newf(HAL_OUT, &(hal_data->stall_warning), comp_id, "%s.stall.stall_warning", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.stall.stall_warning failed\n", name);
+    return -1;
   }
   *(hal_data->stall_warning) = 0.0;
 
-  if (hal_pin_float_newf(HAL_OUT, &(hal_data->slip_deg), comp_id, "%s.stall.slip_deg", FGFDM_MODULE_NAME)) {
-    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.stall.slip_deg failed\n", FGFDM_MODULE_NAME);
-    goto fail2;
+  if (hal_pin_float_newf(HAL_OUT, &(hal_data->slip_deg), comp_id, "%s.stall.slip_deg", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.stall.slip_deg failed\n", name);
+    return -1;
   }
   *(hal_data->slip_deg) = 0.0;
 
-  if (hal_pin_u32_newf(HAL_OUT, &(hal_data->num_engines), comp_id, "%s.engine.num_engines", FGFDM_MODULE_NAME)) {
-    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.engine.num_engines failed\n", FGFDM_MODULE_NAME);
-    goto fail2;
+  return 0;
+}
+
+static int export_engine(FGFDM_HAL_T *hal_data, const char *name) {
+  int i;
+
+  if (hal_pin_u32_newf(HAL_OUT, &(hal_data->num_engines), comp_id, "%s.engine.num_engines", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.engine.num_engines failed\n", name);
+    return -1;
   }
   *(hal_data->num_engines) = 0;
 
   for (i=0; i<FG_MAX_ENGINES; i++) {
-    if (hal_pin_u32_newf(HAL_OUT, &(hal_data->eng_state[i]), comp_id, "%s.engine.%d.eng_state", FGFDM_MODULE_NAME, i)) {
-      rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.engine.%d.eng_state failed\n", FGFDM_MODULE_NAME, i);
-      goto fail2;
+    if (hal_pin_u32_newf(HAL_OUT, &(hal_data->eng_state[i]), comp_id, "%s.engine.%d.eng_state", name, i)) {
+      rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.engine.%d.eng_state failed\n", name, i);
+      return -1;
     }
     *(hal_data->eng_state[i]) = 0;
 
-    if (hal_pin_float_newf(HAL_OUT, &(hal_data->rpm[i]), comp_id, "%s.engine.%d.rpm", FGFDM_MODULE_NAME, i)) {
-      rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.engine.%d.rpm failed\n", FGFDM_MODULE_NAME, i);
-      goto fail2;
+    if (hal_pin_float_newf(HAL_OUT, &(hal_data->rpm[i]), comp_id, "%s.engine.%d.rpm", name, i)) {
+      rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.engine.%d.rpm failed\n", name, i);
+      return -1;
     }
     *(hal_data->rpm[i]) = 0.0;
 
-    if (hal_pin_float_newf(HAL_OUT, &(hal_data->fuel_flow[i]), comp_id, "%s.engine.%d.fuel_flow", FGFDM_MODULE_NAME, i)) {
-      rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.engine.%d.fuel_flow failed\n", FGFDM_MODULE_NAME, i);
-      goto fail2;
+    if (hal_pin_float_newf(HAL_OUT, &(hal_data->fuel_flow[i]), comp_id, "%s.engine.%d.fuel_flow", name, i)) {
+      rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.engine.%d.fuel_flow failed\n", name, i);
+      return -1;
     }
     *(hal_data->fuel_flow[i]) = 0.0;
 
-    if (hal_pin_float_newf(HAL_OUT, &(hal_data->fuel_px[i]), comp_id, "%s.engine.%d.fuel_px", FGFDM_MODULE_NAME, i)) {
-      rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.engine.%d.fuel_px failed\n", FGFDM_MODULE_NAME, i);
-      goto fail2;
+    if (hal_pin_float_newf(HAL_OUT, &(hal_data->fuel_px[i]), comp_id, "%s.engine.%d.fuel_px", name, i)) {
+      rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.engine.%d.fuel_px failed\n", name, i);
+      return -1;
     }
     *(hal_data->fuel_px[i]) = 0.0;
 
-    if (hal_pin_float_newf(HAL_OUT, &(hal_data->egt[i]), comp_id, "%s.engine.%d.egt", FGFDM_MODULE_NAME, i)) {
-      rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.engine.%d.egt failed\n", FGFDM_MODULE_NAME, i);
-      goto fail2;
+    if (hal_pin_float_newf(HAL_OUT, &(hal_data->egt[i]), comp_id, "%s.engine.%d.egt", name, i)) {
+      rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.engine.%d.egt failed\n", name, i);
+      return -1;
     }
     *(hal_data->egt[i]) = 0.0;
 
-    if (hal_pin_float_newf(HAL_OUT, &(hal_data->cht[i]), comp_id, "%s.engine.%d.cht", FGFDM_MODULE_NAME, i)) {
-      rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.engine.%d.cht failed\n", FGFDM_MODULE_NAME, i);
-      goto fail2;
+    if (hal_pin_float_newf(HAL_OUT, &(hal_data->cht[i]), comp_id, "%s.engine.%d.cht", name, i)) {
+      rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.engine.%d.cht failed\n", name, i);
+      return -1;
     }
     *(hal_data->cht[i]) = 0.0;
 
-    if (hal_pin_float_newf(HAL_OUT, &(hal_data->mp_osi[i]), comp_id, "%s.engine.%d.mp_osi", FGFDM_MODULE_NAME, i)) {
-      rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.engine.%d.mp_osi failed\n", FGFDM_MODULE_NAME, i);
-      goto fail2;
+    if (hal_pin_float_newf(HAL_OUT, &(hal_data->mp_osi[i]), comp_id, "%s.engine.%d.mp_osi", name, i)) {
+      rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.engine.%d.mp_osi failed\n", name, i);
+      return -1;
     }
     *(hal_data->mp_osi[i]) = 0.0;
 
-    if (hal_pin_float_newf(HAL_OUT, &(hal_data->tit[i]), comp_id, "%s.engine.%d.tit", FGFDM_MODULE_NAME, i)) {
-      rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.engine.%d.tit failed\n", FGFDM_MODULE_NAME, i);
-      goto fail2;
+    if (hal_pin_float_newf(HAL_OUT, &(hal_data->tit[i]), comp_id, "%s.engine.%d.tit", name, i)) {
+      rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.engine.%d.tit failed\n", name, i);
+      return -1;
     }
     *(hal_data->tit[i]) = 0.0;
 
-    if (hal_pin_float_newf(HAL_OUT, &(hal_data->oil_temp[i]), comp_id, "%s.engine.%d.oil_temp", FGFDM_MODULE_NAME, i)) {
-      rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.engine.%d.oil_temp failed\n", FGFDM_MODULE_NAME, i);
-      goto fail2;
+    if (hal_pin_float_newf(HAL_OUT, &(hal_data->oil_temp[i]), comp_id, "%s.engine.%d.oil_temp", name, i)) {
+      rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.engine.%d.oil_temp failed\n", name, i);
+      return -1;
     }
     *(hal_data->oil_temp[i]) = 0.0;
 
-    if (hal_pin_float_newf(HAL_OUT, &(hal_data->oil_px[i]), comp_id, "%s.engine.%d.oil_px", FGFDM_MODULE_NAME, i)) {
-      rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.engine.%d.oil_px failed\n", FGFDM_MODULE_NAME, i);
-      goto fail2;
+    if (hal_pin_float_newf(HAL_OUT, &(hal_data->oil_px[i]), comp_id, "%s.engine.%d.oil_px", name, i)) {
+      rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.engine.%d.oil_px failed\n", name, i);
+      return -1;
     }
     *(hal_data->oil_px[i]) = 0.0;
   }
 
-  if (hal_pin_u32_newf(HAL_OUT, &(hal_data->num_tanks), comp_id, "%s.cons.num_tanks", FGFDM_MODULE_NAME)) {
-    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.cons.num_tanks failed\n", FGFDM_MODULE_NAME);
-    goto fail2;
+  return 0;
+}
+
+static int export_cons(FGFDM_HAL_T *hal_data, const char *name) {
+  int i;
+
+  if (hal_pin_u32_newf(HAL_OUT, &(hal_data->num_tanks), comp_id, "%s.cons.num_tanks", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.cons.num_tanks failed\n", name);
+    return -1;
   }
   *(hal_data->num_tanks) = 0;
 
   for (i=0; i<FG_MAX_TANKS; i++) {
-    if (hal_pin_float_newf(HAL_OUT, &(hal_data->fuel_quantity[i]), comp_id, "%s.cons.%d.fuel_quantity", FGFDM_MODULE_NAME, i)) {
-      rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.cons.%d.fuel_quantity failed\n", FGFDM_MODULE_NAME, i);
-      goto fail2;
+    if (hal_pin_float_newf(HAL_OUT, &(hal_data->fuel_quantity[i]), comp_id, "%s.cons.%d.fuel_quantity", name, i)) {
+      rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.cons.%d.fuel_quantity failed\n", name, i);
+      return -1;
     }
     *(hal_data->fuel_quantity[i]) = 0.0;
   }
 
-  if (hal_pin_u32_newf(HAL_OUT, &(hal_data->num_wheels), comp_id, "%s.gear.num_wheels", FGFDM_MODULE_NAME)) {
-    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.gear.num_wheels failed\n", FGFDM_MODULE_NAME);
-    goto fail2;
+  return 0;
+}
+
+static int export_gear(FGFDM_HAL_T *hal_data, const char *name) {
+  int i;
+
+  if (hal_pin_u32_newf(HAL_OUT, &(hal_data->num_wheels), comp_id, "%s.gear.num_wheels", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.gear.num_wheels failed\n", name);
+    return -1;
   }
   *(hal_data->num_wheels) = 0;
 
   for (i=0; i<FG_MAX_WHEELS; i++) {
-    if (hal_pin_u32_newf(HAL_OUT, &(hal_data->wow[i]), comp_id, "%s.gear.%d.wow", FGFDM_MODULE_NAME, i)) {
-      rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.gear.%d.wow failed\n", FGFDM_MODULE_NAME, i);
-      goto fail2;
+    if (hal_pin_u32_newf(HAL_OUT, &(hal_data->wow[i]), comp_id, "%s.gear.%d.wow", name, i)) {
+      rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.gear.%d.wow failed\n", name, i);
+      return -1;
     }
     *(hal_data->wow[i]) = 0;
 
-    if (hal_pin_float_newf(HAL_OUT, &(hal_data->gear_pos[i]), comp_id, "%s.gear.%d.gear_pos", FGFDM_MODULE_NAME, i)) {
-      rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.gear.%d.gear_pos failed\n", FGFDM_MODULE_NAME, i);
-      goto fail2;
+    if (hal_pin_float_newf(HAL_OUT, &(hal_data->gear_pos[i]), comp_id, "%s.gear.%d.gear_pos", name, i)) {
+      rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.gear.%d.gear_pos failed\n", name, i);
+      return -1;
     }
     *(hal_data->gear_pos[i]) = 0.0;
 
-    if (hal_pin_float_newf(HAL_OUT, &(hal_data->gear_steer[i]), comp_id, "%s.gear.%d.gear_steer", FGFDM_MODULE_NAME, i)) {
-      rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.gear.%d.gear_steer failed\n", FGFDM_MODULE_NAME, i);
-      goto fail2;
+    if (hal_pin_float_newf(HAL_OUT, &(hal_data->gear_steer[i]), comp_id, "%s.gear.%d.gear_steer", name, i)) {
+      rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.gear.%d.gear_steer failed\n", name, i);
+      return -1;
     }
     *(hal_data->gear_steer[i]) = 0.0;
 
-    if (hal_pin_float_newf(HAL_OUT, &(hal_data->gear_compression[i]), comp_id, "%s.gear.%d.gear_compression", FGFDM_MODULE_NAME, i)) {
-      rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.gear.%d.gear_compression failed\n", FGFDM_MODULE_NAME, i);
-      goto fail2;
+    if (hal_pin_float_newf(HAL_OUT, &(hal_data->gear_compression[i]), comp_id, "%s.gear.%d.gear_compression", name, i)) {
+      rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.gear.%d.gear_compression failed\n", name, i);
+      return -1;
     }
     *(hal_data->gear_compression[i]) = 0.0;
   }
 
-  if (hal_pin_u32_newf(HAL_OUT, &(hal_data->cur_time), comp_id, "%s.env.cur_time", FGFDM_MODULE_NAME)) {
-    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.env.cur_time failed\n", FGFDM_MODULE_NAME);
-    goto fail2;
+  return 0;
+}
+
+static int export_env(FGFDM_HAL_T *hal_data, const char *name) {
+  if (hal_pin_u32_newf(HAL_OUT, &(hal_data->cur_time), comp_id, "%s.env.cur_time", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.env.cur_time failed\n", name);
+    return -1;
   }
   *(hal_data->cur_time) = 0;
 
-  if (hal_pin_s32_newf(HAL_OUT, &(hal_data->warp), comp_id, "%s.env.warp", FGFDM_MODULE_NAME)) {
-    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.env.warp failed\n", FGFDM_MODULE_NAME);
-    goto fail2;
+  if (hal_pin_s32_newf(HAL_OUT, &(hal_data->warp), comp_id, "%s.env.warp", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.env.warp failed\n", name);
+    return -1;
   }
   *(hal_data->warp) = 0;
 
-  if (hal_pin_float_newf(HAL_OUT, &(hal_data->visibility), comp_id, "%s.env.visibility", FGFDM_MODULE_NAME)) {
-    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.env.visibility failed\n", FGFDM_MODULE_NAME);
-    goto fail2;
+  if (hal_pin_float_newf(HAL_OUT, &(hal_data->visibility), comp_id, "%s.env.visibility", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.env.visibility failed\n", name);
+    return -1;
   }
   *(hal_data->visibility) = 0.0;
 
-  if (hal_pin_float_newf(HAL_OUT, &(hal_data->elevator), comp_id, "%s.ctrl.elevator", FGFDM_MODULE_NAME)) {
-    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.ctrl.elevator failed\n", FGFDM_MODULE_NAME);
-    goto fail2;
+  return 0;
+}
+
+static int export_ctrl(FGFDM_HAL_T *hal_data, const char *name) {
+  if (hal_pin_float_newf(HAL_OUT, &(hal_data->elevator), comp_id, "%s.ctrl.elevator", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.ctrl.elevator failed\n", name);
+    return -1;
   }
   *(hal_data->elevator) = 0.0;
 
-  if (hal_pin_float_newf(HAL_OUT, &(hal_data->elevator_trim_tab), comp_id, "%s.ctrl.elevator_trim_tab", FGFDM_MODULE_NAME)) {
-    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.ctrl.elevator_trim_tab failed\n", FGFDM_MODULE_NAME);
-    goto fail2;
+  if (hal_pin_float_newf(HAL_OUT, &(hal_data->elevator_trim_tab), comp_id, "%s.ctrl.elevator_trim_tab", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.ctrl.elevator_trim_tab failed\n", name);
+    return -1;
   }
   *(hal_data->elevator_trim_tab) = 0.0;
 
-  if (hal_pin_float_newf(HAL_OUT, &(hal_data->left_flap), comp_id, "%s.ctrl.left_flap", FGFDM_MODULE_NAME)) {
-    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.ctrl.left_flap failed\n", FGFDM_MODULE_NAME);
-    goto fail2;
+  if (hal_pin_float_newf(HAL_OUT, &(hal_data->left_flap), comp_id, "%s.ctrl.left_flap", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.ctrl.left_flap failed\n", name);
+    return -1;
   }
   *(hal_data->left_flap) = 0.0;
 
-  if (hal_pin_float_newf(HAL_OUT, &(hal_data->right_flap), comp_id, "%s.ctrl.right_flap", FGFDM_MODULE_NAME)) {
-    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.ctrl.right_flap failed\n", FGFDM_MODULE_NAME);
-    goto fail2;
+  if (hal_pin_float_newf(HAL_OUT, &(hal_data->right_flap), comp_id, "%s.ctrl.right_flap", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.ctrl.right_flap failed\n", name);
+    return -1;
   }
   *(hal_data->right_flap) = 0.0;
 
-  if (hal_pin_float_newf(HAL_OUT, &(hal_data->left_aileron), comp_id, "%s.ctrl.left_aileron", FGFDM_MODULE_NAME)) {
-    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.ctrl.left_aileron failed\n", FGFDM_MODULE_NAME);
-    goto fail2;
+  if (hal_pin_float_newf(HAL_OUT, &(hal_data->left_aileron), comp_id, "%s.ctrl.left_aileron", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.ctrl.left_aileron failed\n", name);
+    return -1;
   }
   *(hal_data->left_aileron) = 0.0;
 
-  if (hal_pin_float_newf(HAL_OUT, &(hal_data->right_aileron), comp_id, "%s.ctrl.right_aileron", FGFDM_MODULE_NAME)) {
-    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.ctrl.right_aileron failed\n", FGFDM_MODULE_NAME);
-    goto fail2;
+  if (hal_pin_float_newf(HAL_OUT, &(hal_data->right_aileron), comp_id, "%s.ctrl.right_aileron", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.ctrl.right_aileron failed\n", name);
+    return -1;
   }
   *(hal_data->right_aileron) = 0.0;
 
-  if (hal_pin_float_newf(HAL_OUT, &(hal_data->rudder), comp_id, "%s.ctrl.rudder", FGFDM_MODULE_NAME)) {
-    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.ctrl.rudder failed\n", FGFDM_MODULE_NAME);
-    goto fail2;
+  if (hal_pin_float_newf(HAL_OUT, &(hal_data->rudder), comp_id, "%s.ctrl.rudder", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.ctrl.rudder failed\n", name);
+    return -1;
   }
   *(hal_data->rudder) = 0.0;
 
-  if (hal_pin_float_newf(HAL_OUT, &(hal_data->nose_wheel), comp_id, "%s.ctrl.nose_wheel", FGFDM_MODULE_NAME)) {
-    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.ctrl.nose_wheel failed\n", FGFDM_MODULE_NAME);
-    goto fail2;
+  if (hal_pin_float_newf(HAL_OUT, &(hal_data->nose_wheel), comp_id, "%s.ctrl.nose_wheel", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.ctrl.nose_wheel failed\n", name);
+    return -1;
   }
   *(hal_data->nose_wheel) = 0.0;
 
-  if (hal_pin_float_newf(HAL_OUT, &(hal_data->speedbrake), comp_id, "%s.ctrl.speedbrake", FGFDM_MODULE_NAME)) {
-    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.ctrl.speedbrake failed\n", FGFDM_MODULE_NAME);
-    goto fail2;
+  if (hal_pin_float_newf(HAL_OUT, &(hal_data->speedbrake), comp_id, "%s.ctrl.speedbrake", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.ctrl.speedbrake failed\n", name);
+    return -1;
   }
   *(hal_data->speedbrake) = 0.0;
 
-  if (hal_pin_float_newf(HAL_OUT, &(hal_data->spoilers), comp_id, "%s.ctrl.spoilers", FGFDM_MODULE_NAME)) {
-    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.ctrl.spoilers failed\n", FGFDM_MODULE_NAME);
-    goto fail2;
+  if (hal_pin_float_newf(HAL_OUT, &(hal_data->spoilers), comp_id, "%s.ctrl.spoilers", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.ctrl.spoilers failed\n", name);
+    return -1;
   }
   *(hal_data->spoilers) = 0.0;
 
-  // initialize internal values
-  hal_data->timeout = 0;
+  return 0;
+}
 
-  // export read function
-  rtapi_snprintf(name, HAL_NAME_LEN, "%s.read", FGFDM_MODULE_NAME);
-  if (hal_export_funct(name, fgfdm_read, NULL, 0, 0, comp_id)) {
-    rtapi_print_msg (RTAPI_MSG_ERR, "FGFDM: read funct export failed\n");
-    goto fail2;
+static void read_pos(FGFDM_HAL_T *hal_data, FGNetFDM *data) {
+  *(hal_data->longitude) = RAD2DEG(data->longitude);
+  *(hal_data->latitude) = RAD2DEG(data->latitude);
+  *(hal_data->altitude) = data->altitude;
+  *(hal_data->agl) = data->agl;
+  *(hal_data->phi) = RAD2DEG(data->phi);
+  *(hal_data->theta) = RAD2DEG(data->theta);
+  *(hal_data->psi) = RAD2DEG(data->psi);
+  *(hal_data->alpha) = RAD2DEG(data->alpha);
+  *(hal_data->beta) = RAD2DEG(data->beta);
+}
+
+static void read_velo(FGFDM_HAL_T *hal_data, FGNetFDM *data) {
+  *(hal_data->phidot) = RAD2DEG(data->phidot);
+  *(hal_data->thetadot) = RAD2DEG(data->thetadot);
+  *(hal_data->psidot) = RAD2DEG(data->psidot);
+  *(hal_data->vcas) = data->vcas;
+  *(hal_data->climb_rate) = data->climb_rate;
+  *(hal_data->v_north) = data->v_north;
+  *(hal_data->v_east) = data->v_east;
+  *(hal_data->v_down) = data->v_down;
+  *(hal_data->v_body_u) = data->v_body_u;
+  *(hal_data->v_body_v) = data->v_body_v;
+  *(hal_data->v_body_w) = data->v_body_w;
+}
+
+static void read_accel(FGFDM_HAL_T *hal_data, FGNetFDM *data) {
+  *(hal_data->A_X_pilot) = data->A_X_pilot;
+  *(hal_data->A_Y_pilot) = data->A_Y_pilot;
+  *(hal_data->A_Z_pilot) = data->A_Z_pilot;
+}
+
+static void read_stall(FGFDM_HAL_T *hal_data, FGNetFDM *data) {
+  *(hal_data->stall_warning) = data->stall_warning;
+  *(hal_data->slip_deg) = data->slip_deg;
+}
+
+static void read_engine(FGFDM_HAL_T *hal_data, FGNetFDM *data) {
+  int i;
+
+  *(hal_data->num_engines) = data->num_engines;
+  for (i=0; i<FG_MAX_ENGINES; i++) {
+    *(hal_data->eng_state[i]) = data->eng_state[i];
+    *(hal_data->rpm[i]) = data->rpm[i];
+    *(hal_data->fuel_flow[i]) = data->fuel_flow[i];
+    *(hal_data->fuel_px[i]) = data->fuel_px[i];
+    *(hal_data->egt[i]) = data->egt[i];
+    *(hal_data->cht[i]) = data->cht[i];
+    *(hal_data->mp_osi[i]) = data->mp_osi[i];
+    *(hal_data->tit[i]) = data->tit[i];
+    *(hal_data->oil_temp[i]) = data->oil_temp[i];
+    *(hal_data->oil_px[i]) = data->oil_px[i];
+  }
+}
+
+static void read_cons(FGFDM_HAL_T *hal_data, FGNetFDM *data) {
+  int i;
+
+  *(hal_data->num_tanks) = data->num_tanks;
+  for (i=0; i<FG_MAX_TANKS; i++) {
+    *(hal_data->fuel_quantity[i]) = data->fuel_quantity[i];
+  }
+}
+
+static void read_gear(FGFDM_HAL_T *hal_data, FGNetFDM *data) {
+  int i;
+
+  *(hal_data->num_wheels) = data->num_wheels;
+  for (i=0; i<FG_MAX_WHEELS; i++) {
+    *(hal_data->wow[i]) = data->wow[i];
+    *(hal_data->gear_pos[i]) = data->gear_pos[i];
+    *(hal_data->gear_steer[i]) = data->gear_steer[i];
+    *(hal_data->gear_compression[i]) = data->gear_compression[i];
+  }
+}
+
+static void read_env(FGFDM_HAL_T *hal_data, FGNetFDM *data) {
+  *(hal_data->cur_time) = data->cur_time;
+  *(hal_data->warp) = data->warp;
+  *(hal_data->visibility) = data->visibility;
+}
+
+static void read_ctrl(FGFDM_HAL_T *hal_data, FGNetFDM *data) {
+  *(hal_data->elevator) = data->elevator;
+  *(hal_data->elevator_trim_tab) = data->elevator_trim_tab;
+  *(hal_data->left_flap) = data->left_flap;
+  *(hal_data->right_flap) = data->right_flap;
+  *(hal_data->left_aileron) = data->left_aileron;
+  *(hal_data->right_aileron) = data->right_aileron;
+  *(hal_data->rudder) = data->rudder;
+  *(hal_data->nose_wheel) = data->nose_wheel;
+  *(hal_data->speedbrake) = data->speedbrake;
+  *(hal_data->spoilers) = data->spoilers;
+}
+
+static const FGFDM_GROUP_T fgfdm_groups[] = {
+  { "pos", export_pos, read_pos },
+  { "velo", export_velo, read_velo },
+  { "accel", export_accel, read_accel },
+  { "stall", export_stall, read_stall },
+  { "engine", export_engine, read_engine },
+  { "cons", export_cons, read_cons },
+  { "gear", export_gear, read_gear },
+  { "env", export_env, read_env },
+  { "ctrl", export_ctrl, read_ctrl },
+};
+
+#define FGFDM_GROUP_COUNT (sizeof(fgfdm_groups) / sizeof(fgfdm_groups[0]))
+#define FGFDM_GROUP_POS   (1 << 0)
+
+// parse comma separated group list into a bit mask
+static int parse_groups(const char *str, unsigned int *mask) {
+  const char *end;
+  int i, len;
+
+  *mask = 0;
+  if (str == NULL || strcmp(str, "all") == 0) {
+    *mask = (1 << FGFDM_GROUP_COUNT) - 1;
+    return 0;
+  }
+
+  while (*str != 0) {
+    for (end = str; *end != 0 && *end != ','; end++);
+    len = end - str;
+
+    for (i = 0; i < FGFDM_GROUP_COUNT; i++) {
+      if (strlen(fgfdm_groups[i].name) == len && strncmp(fgfdm_groups[i].name, str, len) == 0) {
+        break;
+      }
+    }
+    if (i == FGFDM_GROUP_COUNT) {
+      return -1;
+    }
+    *mask |= 1 << i;
+
+    str = (*end == ',') ? end + 1 : end;
+  }
+
+  return 0;
+}
+
+static void read_generic(FGFDM_INST_T *inst, const double *values) {
+  FGFDM_HAL_T *hal_data = inst->hal_data;
+  int i;
+
+  for (i = 0; i < inst->gen_count; i++) {
+    switch (inst->gen_type[i]) {
+      case FGFDM_GENERIC_TYPE_BOOL:
+        *(hal_data->generic[i].b) = (values[i] != 0.0);
+        break;
+      case FGFDM_GENERIC_TYPE_INT:
+        *(hal_data->generic[i].s) = (hal_s32_t) values[i];
+        break;
+      default:
+        *(hal_data->generic[i].f) = values[i];
+        break;
+    }
+  }
+}
+
+static int export_generic(FGFDM_INST_T *inst) {
+  FGFDM_HAL_T *hal_data = inst->hal_data;
+  FGFDM_GENERIC_LAYOUT_T *layout = &inst->shmem->layout;
+  const char *name = inst->name;
+  const char *field;
+  FGFDM_GENERIC_PIN_T *pin;
+  static const double zero[FGFDM_GENERIC_MAX_FIELDS];
+  int i, ret;
+
+  for (i = 0; i < layout->count; i++) {
+    field = layout->field[i].name;
+    pin = &hal_data->generic[i];
+    inst->gen_type[i] = layout->field[i].type;
+    switch (inst->gen_type[i]) {
+      case FGFDM_GENERIC_TYPE_BOOL:
+        ret = hal_pin_bit_newf(HAL_OUT, &(pin->b), comp_id, "%s.generic.%s", name, field);
+        break;
+      case FGFDM_GENERIC_TYPE_INT:
+        ret = hal_pin_s32_newf(HAL_OUT, &(pin->s), comp_id, "%s.generic.%s", name, field);
+        break;
+      default:
+        ret = hal_pin_float_newf(HAL_OUT, &(pin->f), comp_id, "%s.generic.%s", name, field);
+        break;
+    }
+    if (ret) {
+      rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.generic.%s failed\n", name, field);
+      return -1;
+    }
+  }
+  inst->gen_count = layout->count;
+  inst->gen_hash = layout->hash;
+
+  // all values start at zero
+  read_generic(inst, zero);
+  return 0;
+}
+
+static long long update_data_age(FGFDM_INST_T *inst) {
+  FGFDM_HAL_T *hal_data = inst->hal_data;
+  long long age;
+
+  // age of the exposed frame against the RT clock, saturated to u32
+  age = fgfdm_get_time_ns() - (long long) inst->rd_buffer[inst->rd_index].rx_time;
+  if (age < 0) {
+    age = 0;
+  }
+  if (age > 0xffffffffLL) {
+    age = 0xffffffffLL;
+  }
+  *(hal_data->data_age_ns) = age;
+  return age;
+}
+
+// dead-reckoning of the pos group: advance the exposed frame by its
+// rates (first order) up to the configured horizon
+static void extrapolate_pos(FGFDM_INST_T *inst, long long age) {
+  FGFDM_HAL_T *hal_data = inst->hal_data;
+  FGNetFDM *data = &inst->rd_buffer[inst->rd_index].data;
+  double dt, dn, de, dd;
+
+  if (age > extrapolate_ns) {
+    age = extrapolate_ns;
+  }
+  *(hal_data->extrapolated_ns) = age;
+  dt = age * 1e-9;
+
+  // attitude from body rates
+  *(hal_data->phi) = RAD2DEG(data->phi + data->phidot * dt);
+  *(hal_data->theta) = RAD2DEG(data->theta + data->thetadot * dt);
+  *(hal_data->psi) = RAD2DEG(data->psi + data->psidot * dt);
+
+  // position from NED velocities (ft/s)
+  dn = data->v_north * FT2M * dt;
+  de = data->v_east * FT2M * dt;
+  dd = data->v_down * FT2M * dt;
+  *(hal_data->latitude) = RAD2DEG(data->latitude + dn * (1.0 / EARTH_RADIUS_M));
+  *(hal_data->longitude) = RAD2DEG(data->longitude + de * hal_data->dr_lon_scale);
+  *(hal_data->altitude) = data->altitude - dd;
+  *(hal_data->agl) = data->agl - dd;
+}
+
+static void update_frame_period(FGFDM_HAL_T *hal_data, long long delta, uint32_t frames) {
+  uint32_t period;
+
+  if (delta < 0 || frames == 0) {
+    return;
+  }
+
+  // saturate to u32 before dividing, avoids 64 bit division in kernel
+  period = (delta > 0xffffffffLL) ? 0xffffffff : (uint32_t) delta;
+  *(hal_data->frame_period_ns) = period / frames;
+}
+
+#ifndef __KERNEL__
+
+// uspace only: fgfdm.read drains the UDP socket itself and publishes
+// into a private ring, saving the listener wakeup and shmem handoff
+struct fgfdm_direct {
+  int sock;
+  uint32_t msgno;
+  struct mmsghdr hdr[FGFDM_DIRECT_BATCH];
+  struct iovec iov[FGFDM_DIRECT_BATCH];
+  char cmsg[FGFDM_DIRECT_BATCH][CMSG_SPACE(sizeof(struct timespec))];
+  // one wire buffer per datagram, a bad one can not hide a good one
+  uint8_t wire[FGFDM_DIRECT_BATCH][FG_NET_FDM_WIRE_MAX];
+};
+
+static int direct_open(FGFDM_INST_T *inst, int port) {
+  FGFDM_DIRECT_T *direct;
+  struct sockaddr_in addr;
+  int i, on = 1;
+
+  direct = fgfdm_zalloc(sizeof(FGFDM_DIRECT_T));
+  if (direct == NULL) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: unable to allocate socket memory for %s\n", inst->name);
+    return -1;
+  }
+  inst->direct = direct;
+
+  // private ring, a running fgfdm_lsnr can not interfere
+  inst->shmem = fgfdm_zalloc(fgfdm_shmem_size(ring_depth));
+  if (inst->shmem == NULL) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: unable to allocate ring memory for %s\n", inst->name);
+    direct->sock = -1;
+    return -1;
+  }
+  inst->shmem->depth = ring_depth;
+  ntohfdm_init();
+
+  direct->sock = socket(AF_INET, SOCK_DGRAM, 0);
+  if (direct->sock < 0) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: unable to create UDP socket for %s\n", inst->name);
+    return -1;
+  }
+
+  // kernel receive timestamps keep data-age-ns independent of the servo period
+  if (setsockopt(direct->sock, SOL_SOCKET, SO_TIMESTAMPNS, (void *) &on, sizeof(on))) {
+    rtapi_print_msg(RTAPI_MSG_WARN, "FGFDM: unable to enable receive timestamps for %s\n", inst->name);
+  }
+
+  bzero(&addr, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(port);
+  if (bind(direct->sock, (struct sockaddr *) &addr, sizeof(addr))) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: unable to bind UDP port %d for %s\n", port, inst->name);
+    return -1;
+  }
+
+  for (i = 0; i < FGFDM_DIRECT_BATCH; i++) {
+    direct->iov[i].iov_base = direct->wire[i];
+    direct->iov[i].iov_len = sizeof(direct->wire[i]);
+    direct->hdr[i].msg_hdr.msg_iov = &direct->iov[i];
+    direct->hdr[i].msg_hdr.msg_iovlen = 1;
+    direct->hdr[i].msg_hdr.msg_control = direct->cmsg[i];
+  }
+
+  return 0;
+}
+
+static void direct_close(FGFDM_INST_T *inst) {
+  if (inst->direct == NULL) {
+    return;
+  }
+  if (inst->direct->sock >= 0) {
+    close(inst->direct->sock);
+  }
+  fgfdm_free(inst->shmem);
+  fgfdm_free(inst->direct);
+}
+
+// kernel stamps are CLOCK_REALTIME, convert them via their age
+static long long direct_rx_time(struct msghdr *mh, long long now) {
+  struct cmsghdr *cmsg;
+  struct timespec *stamp, now_real;
+  long long age;
+
+  for (cmsg = CMSG_FIRSTHDR(mh); cmsg != NULL; cmsg = CMSG_NXTHDR(mh, cmsg)) {
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+      stamp = (struct timespec *) CMSG_DATA(cmsg);
+      clock_gettime(CLOCK_REALTIME, &now_real);
+      age = (now_real.tv_sec - stamp->tv_sec) * 1000000000LL + (now_real.tv_nsec - stamp->tv_nsec);
+      return (age > 0) ? now - age : now;
+    }
+  }
+
+  return now;
+}
+
+// only the newest valid datagram of a batch is published, like
+// fgfdm_lsnr does
+static void direct_poll(FGFDM_INST_T *inst) {
+  FGFDM_DIRECT_T *direct = inst->direct;
+  FGFDM_BUFFER_T *buffer;
+  struct mmsghdr *mh;
+  long long now;
+  int i, n;
+
+  for (i = 0; i < FGFDM_DIRECT_BATCH; i++) {
+    direct->hdr[i].msg_hdr.msg_controllen = sizeof(direct->cmsg[i]);
+  }
+
+  n = recvmmsg(direct->sock, direct->hdr, FGFDM_DIRECT_BATCH, MSG_DONTWAIT, NULL);
+  if (n <= 0) {
+    return;
+  }
+
+  // decode from the newest backwards, the slot is at least one ring
+  // depth behind the readers, so a rejected decode is never read
+  buffer = fgfdm_shmem_write_begin(inst->shmem, ring_mask);
+  for (i = n - 1; i >= 0; i--) {
+    mh = &direct->hdr[i];
+    if (mh->msg_hdr.msg_flags & MSG_TRUNC) {
+      continue;
+    }
+    memcpy(&buffer->data, direct->wire[i], sizeof(FGNetFDM));
+    if (!ntohfdm_any(&buffer->data, direct->wire[i] + sizeof(FGNetFDM), mh->msg_len)) {
+      break;
+    }
+  }
+  if (i < 0) {
+    fgfdm_shmem_write_abort(buffer);
+    return;
+  }
+
+  now = fgfdm_get_time_ns();
+  buffer->rx_time = direct_rx_time(&mh->msg_hdr, now);
+  buffer->timestamp = buffer->rx_time / 1000000LL;
+  buffer->msgno = direct->msgno;
+  buffer->data_valid = 1;
+  direct->msgno++;
+  buffer->pub_time = now;
+  fgfdm_shmem_write_commit(inst->shmem, buffer);
+}
+
+#else
+
+static int direct_open(FGFDM_INST_T *inst, int port) {
+  rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: ports= requires a uspace build\n");
+  return -1;
+}
+
+static void direct_close(FGFDM_INST_T *inst) {
+}
+
+static void direct_poll(FGFDM_INST_T *inst) {
+}
+
+#endif
+
+static void read_instance(FGFDM_INST_T *inst, long period) {
+  FGFDM_SHMEM_T *shmem = inst->shmem;
+  FGFDM_HAL_T *hal_data = inst->hal_data;
+  FGFDM_BUFFER_T *buffer;
+  FGNetFDM *data;
+  const FGFDM_GROUP_T *group;
+  uint32_t head, tail, pending, keep;
+  int i, retry, count;
+  long long age;
+  double clat;
+
+  // receive pending datagrams in direct mode
+  if (inst->direct != NULL) {
+    direct_poll(inst);
+  }
+
+  // check if data available
+  head = fgfdm_shmem_head(shmem);
+  tail = hal_data->tail;
+  if ((int32_t) (head - tail) < 0) {
+    // listener restarted and reset the ring, start over with its frames
+    tail = 0;
+    hal_data->tail = 0;
+    shmem->tail = 0;
+    shmem->lossless = (read_mode_id != FGFDM_READ_LATEST);
+  }
+  if (head == tail) {
+    *(hal_data->frames_drained) = 0;
+    *(hal_data->new_frame) = 0;
+    age = update_data_age(inst);
+    if (hal_data->timeout > 0) {
+      hal_data->timeout -= period;
+    } else {
+      *(hal_data->data_valid) = 0;
+    }
+    if (extrapolate_ns > 0 && inst->gen_count == 0 && *(hal_data->data_valid)) {
+      extrapolate_pos(inst, age);
+    }
+    return;
+  }
+
+  // in latest mode only the newest frame is read, otherwise
+  // the oldest slot may already be reused by the listener
+  keep = (read_mode_id == FGFDM_READ_LATEST) ? 1 : ring_mask;
+
+  count = 0;
+  retry = 0;
+  while (tail != head) {
+    // skip frames that are overwritten or not of interest
+    pending = head - tail;
+    if (pending > keep) {
+      *(hal_data->overwritten) += pending - keep;
+      tail = head - keep;
+    }
+
+    // read into the spare buffer, retry with a fresh head if torn
+    if (fgfdm_shmem_read(shmem, ring_mask, tail, &inst->rd_buffer[!inst->rd_index])) {
+      (*(hal_data->torn_reads))++;
+      if (++retry > FGFDM_READ_RETRIES) {
+        break;
+      }
+      head = fgfdm_shmem_head(shmem);
+      continue;
+    }
+    inst->rd_index = !inst->rd_index;
+    tail++;
+    count++;
+
+    if (read_mode_id != FGFDM_READ_DRAIN) {
+      break;
+    }
+  }
+
+  // update consumer position, the frames must be copied before the
+  // listener sees their slots free
+  hal_data->tail = tail;
+  fgfdm_smp_mb();
+  shmem->tail = tail;
+  shmem->lossless = (read_mode_id != FGFDM_READ_LATEST);
+
+  *(hal_data->frames_drained) = count;
+  *(hal_data->new_frame) = (count > 0);
+  age = update_data_age(inst);
+  if (count == 0) {
+    return;
+  }
+  buffer = &inst->rd_buffer[inst->rd_index];
+
+  // measure mean packet period since the last exposed frame
+  if (hal_data->last_rx_time != 0) {
+    update_frame_period(hal_data, buffer->rx_time - hal_data->last_rx_time, buffer->frame - hal_data->last_frame);
+  }
+  hal_data->last_rx_time = buffer->rx_time;
+  hal_data->last_frame = buffer->frame;
+
+  // set statistics data
+  hal_data->timeout = FGFDM_LISTENER_TIMEOUT * 1000000LL;
+  *(hal_data->data_valid) = buffer->data_valid;
+  *(hal_data->timestamp) = buffer->timestamp;
+  *(hal_data->msgno) = buffer->msgno;
+
+  // pins were created for another feed layout (listener restarted
+  // or started after fgfdm was loaded)
+  if (shmem->layout.hash != inst->gen_hash) {
+    if (!inst->gen_mismatch) {
+      rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: feed layout of %s differs from the one at load time, reload fgfdm after starting fgfdm_lsnr\n", inst->name);
+      inst->gen_mismatch = 1;
+    }
+    *(hal_data->data_valid) = 0;
+    *(hal_data->new_frame) = 0;
+    *(hal_data->frames_drained) = 0;
+    return;
+  }
+  inst->gen_mismatch = 0;
+
+  // tag the frame, the record is completed by fgfdm.trace
+  if (trace != NULL) {
+    inst->trace_rec.instance = inst - instances;
+    inst->trace_rec.msgno = buffer->msgno;
+    inst->trace_rec.frame = buffer->frame;
+    inst->trace_rec.data_valid = buffer->data_valid;
+    inst->trace_rec.rx_time = buffer->rx_time;
+    inst->trace_rec.pub_time = buffer->pub_time;
+    inst->trace_rec.read_time = fgfdm_get_time_ns();
+    inst->trace_pending = 1;
+  }
+
+  // invalid frames keep the last good values
+  if (!buffer->data_valid) {
+    return;
+  }
+
+  // generic protocol values are already decoded
+  if (inst->gen_count > 0) {
+    read_generic(inst, buffer->generic);
+    return;
+  }
+
+  // update selected flightgear data
+  data = &buffer->data;
+  for (i = 0, group = fgfdm_groups; i < FGFDM_GROUP_COUNT; i++, group++) {
+    if (group_mask & (1 << i)) {
+      group->read(hal_data, data);
+    }
+  }
+
+  // extrapolate from the new frame
+  if (extrapolate_ns > 0) {
+    // meridian convergence, only evaluated on new frames
+    clat = cos(data->latitude);
+    hal_data->dr_lon_scale = (clat > 1e-6) ? 1.0 / (EARTH_RADIUS_M * clat) : 0.0;
+    extrapolate_pos(inst, age);
+  }
+}
+
+void fgfdm_read(void *arg, long period) {
+  long long start;
+  int i;
+
+  start = fgfdm_prof_start(prof_data);
+
+  for (i = 0; i < inst_count; i++) {
+    read_instance(&instances[i], period);
+  }
+
+  fgfdm_prof_end(prof_data, start);
+}
+
+// add behind the last consumer of the frame data (e.g. fgaxis) to
+// stamp the output time of the frames tagged by fgfdm.read
+void fgfdm_trace(void *arg, long period) {
+  FGFDM_INST_T *inst;
+  long long now;
+  int i;
+
+  now = fgfdm_get_time_ns();
+  for (i = 0; i < inst_count; i++) {
+    inst = &instances[i];
+    if (inst->trace_pending) {
+      inst->trace_rec.out_time = now;
+      fgfdm_trace_put(trace, &inst->trace_rec);
+      inst->trace_pending = 0;
+    }
+  }
+}
+
+// snapshot the send pins for fgfdm_sndr
+void fgfdm_write(void *arg, long period) {
+  FGFDM_SNDR_SAMPLE_T *sample;
+  int i;
+
+  sample = fgfdm_sndr_write_begin(sndr_shmem);
+  sample->time = fgfdm_get_time_ns();
+  for (i = 0; i < send_values; i++) {
+    sample->value[i] = *(send_data->value[i]);
+  }
+  fgfdm_sndr_write_commit(sndr_shmem, sample);
+}
+
+static int export_instance(FGFDM_INST_T *inst) {
+  const char *name = inst->name;
+  FGFDM_HAL_T *hal_data;
+  const FGFDM_GROUP_T *group;
+  int i;
+
+  // alloc hal memory
+  if ((hal_data = hal_malloc(sizeof(FGFDM_HAL_T))) == NULL) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: hal_malloc() failed\n");
+    return -1;
+  }
+  inst->hal_data = hal_data;
+
+  // export pins
+  if (hal_pin_bit_newf(HAL_OUT, &(hal_data->data_valid), comp_id, "%s.data-valid", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.data-valid failed\n", name);
+    return -1;
+  }
+  *(hal_data->data_valid) = 0;
+
+  if (hal_pin_u32_newf(HAL_OUT, &(hal_data->timestamp), comp_id, "%s.timestamp", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.timestamp failed\n", name);
+    return -1;
+  }
+  *(hal_data->timestamp) = 0;
+
+  if (hal_pin_u32_newf(HAL_OUT, &(hal_data->msgno), comp_id, "%s.msgno", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.msgno failed\n", name);
+    return -1;
+  }
+  *(hal_data->msgno) = 0;
+
+  if (hal_pin_u32_newf(HAL_OUT, &(hal_data->data_age_ns), comp_id, "%s.data-age-ns", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.data-age-ns failed\n", name);
+    return -1;
+  }
+  *(hal_data->data_age_ns) = 0;
+
+  if (hal_pin_bit_newf(HAL_OUT, &(hal_data->new_frame), comp_id, "%s.new-frame", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.new-frame failed\n", name);
+    return -1;
+  }
+  *(hal_data->new_frame) = 0;
+
+  if (hal_pin_u32_newf(HAL_OUT, &(hal_data->frame_period_ns), comp_id, "%s.frame-period-ns", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.frame-period-ns failed\n", name);
+    return -1;
+  }
+  *(hal_data->frame_period_ns) = 0;
+
+  if (hal_pin_u32_newf(HAL_OUT, &(hal_data->torn_reads), comp_id, "%s.torn-reads", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.torn-reads failed\n", name);
+    return -1;
+  }
+  *(hal_data->torn_reads) = 0;
+
+  if (hal_pin_u32_newf(HAL_OUT, &(hal_data->overwritten), comp_id, "%s.overwritten", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.overwritten failed\n", name);
+    return -1;
+  }
+  *(hal_data->overwritten) = 0;
+
+  if (hal_pin_u32_newf(HAL_OUT, &(hal_data->frames_drained), comp_id, "%s.frames-drained", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.frames-drained failed\n", name);
+    return -1;
+  }
+  *(hal_data->frames_drained) = 0;
+
+  if (hal_pin_u32_newf(HAL_OUT, &(hal_data->extrapolated_ns), comp_id, "%s.extrapolated-ns", name)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.extrapolated-ns failed\n", name);
+    return -1;
+  }
+  *(hal_data->extrapolated_ns) = 0;
+
+  // generic protocol feeds get their pins from the listener layout,
+  // FGNetFDM feeds the selected pin groups
+  if (inst->shmem->layout.count > 0) {
+    if (export_generic(inst)) {
+      return -1;
+    }
+  } else {
+    for (i = 0, group = fgfdm_groups; i < FGFDM_GROUP_COUNT; i++, group++) {
+      if ((group_mask & (1 << i)) && group->export(hal_data, name)) {
+        return -1;
+      }
+    }
+  }
+
+  // initialize internal values
+  hal_data->timeout = 0;
+  hal_data->tail = fgfdm_shmem_head(inst->shmem);
+  hal_data->last_frame = 0;
+  hal_data->last_rx_time = 0;
+  hal_data->dr_lon_scale = 0.0;
+
+  return 0;
+}
+
+static void free_instances(void) {
+  int i;
+
+  for (i = 0; i < inst_count; i++) {
+    // the listener must not wait for a reader that is gone
+    if (instances[i].direct == NULL && instances[i].shmem != NULL) {
+      instances[i].shmem->lossless = 0;
+    }
+    if (instances[i].shmem_id >= 0) {
+      rtapi_shmem_delete(instances[i].shmem_id, comp_id);
+    }
+    direct_close(&instances[i]);
+  }
+  fgfdm_free(instances);
+}
+
+static int init_trace(void) {
+  trace_shmem_id = rtapi_shmem_new(FGFDM_TRACE_SHMEM_KEY, comp_id, fgfdm_trace_size(trace_depth));
+  if (trace_shmem_id < 0) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: couldn't allocate trace shared memory\n");
+    return -1;
+  }
+  if (fgfdm_rtapi_shmem_getptr(trace_shmem_id, (void **) &trace) < 0) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: couldn't map trace shared memory\n");
+    return -1;
+  }
+
+  // a running drain tool may have created the segment already
+  if (trace->depth == 0) {
+    trace->head = 0;
+    trace->tail = 0;
+    trace->dropped = 0;
+    trace->depth = trace_depth;
+  }
+  if (trace->depth != trace_depth) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: trace_depth %d does not match trace ring depth %u\n", trace_depth, trace->depth);
+    trace = NULL;
+    return -1;
+  }
+
+  return 0;
+}
+
+static void free_trace(void) {
+  if (trace_shmem_id >= 0) {
+    rtapi_shmem_delete(trace_shmem_id, comp_id);
+  }
+}
+
+static int init_send(void) {
+  int i;
+
+  sndr_shmem_id = rtapi_shmem_new(FGFDM_SNDR_SHMEM_KEY, comp_id, sizeof(FGFDM_SNDR_SHMEM_T));
+  if (sndr_shmem_id < 0) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: couldn't allocate sender shared memory\n");
+    return -1;
+  }
+  if (fgfdm_rtapi_shmem_getptr(sndr_shmem_id, (void **) &sndr_shmem) < 0) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: couldn't map sender shared memory\n");
+    return -1;
+  }
+
+  if ((send_data = hal_malloc(sizeof(FGFDM_SEND_HAL_T))) == NULL) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: hal_malloc() failed\n");
+    return -1;
+  }
+  for (i = 0; i < send_values; i++) {
+    if (hal_pin_float_newf(HAL_IN, &(send_data->value[i]), comp_id, "%s.send.value-%02d", FGFDM_MODULE_NAME, i)) {
+      rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: exporting pin %s.send.value-%02d failed\n", FGFDM_MODULE_NAME, i);
+      return -1;
+    }
+    *(send_data->value[i]) = 0.0;
+  }
+
+  // a running sender keeps its position, the sample count tells
+  // it how many values are valid
+  sndr_shmem->count = send_values;
+
+  return 0;
+}
+
+static void free_send(void) {
+  if (sndr_shmem_id >= 0) {
+    if (sndr_shmem != NULL) {
+      sndr_shmem->count = 0;
+    }
+    rtapi_shmem_delete(sndr_shmem_id, comp_id);
+  }
+}
+
+int rtapi_app_main(void) {
+  char name[HAL_NAME_LEN + 1];
+  FGFDM_INST_T *inst;
+  int i;
+
+  // connect to the HAL
+  if ((comp_id = hal_init (FGFDM_MODULE_NAME)) < 0) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: hal_init() failed\n");
+    goto fail0;
+  }
+
+  // check parameters
+  if (!fgfdm_shmem_depth_valid(ring_depth)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: invalid ring_depth %d (must be a power of two between 2 and %d)\n", ring_depth, FGFDM_RING_DEPTH_MAX);
+    goto fail1;
+  }
+  ring_mask = ring_depth - 1;
+
+  if (strcmp(read_mode, "latest") == 0) {
+    read_mode_id = FGFDM_READ_LATEST;
+  } else if (strcmp(read_mode, "fifo") == 0) {
+    read_mode_id = FGFDM_READ_FIFO;
+  } else if (strcmp(read_mode, "drain") == 0) {
+    read_mode_id = FGFDM_READ_DRAIN;
+  } else {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: invalid read_mode %s\n", read_mode);
+    goto fail1;
+  }
+
+  if (parse_groups(groups, &group_mask)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: invalid groups %s\n", groups);
+    goto fail1;
+  }
+
+  if (extrapolate_ms < 0 || extrapolate_ms > FGFDM_LISTENER_TIMEOUT) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: invalid extrapolate_ms %d (must be between 0 and %d)\n", extrapolate_ms, FGFDM_LISTENER_TIMEOUT);
+    goto fail1;
+  }
+  if (extrapolate_ms > 0 && !(group_mask & FGFDM_GROUP_POS)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: extrapolate_ms requires the pos group\n");
+    goto fail1;
+  }
+  extrapolate_ns = extrapolate_ms * 1000000LL;
+
+  if (send_values < 0 || send_values > FGFDM_SNDR_MAX_VALUES) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: invalid send_values %d (must be between 0 and %d)\n", send_values, FGFDM_SNDR_MAX_VALUES);
+    goto fail1;
+  }
+
+  if (trace_depth != 0 && !fgfdm_trace_depth_valid(trace_depth)) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: invalid trace_depth %d (must be 0 or a power of two between 2 and %d)\n", trace_depth, FGFDM_TRACE_DEPTH_MAX);
+    goto fail1;
+  }
+
+  // setup instances
+  if (count > 0 && names[0] != NULL) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: count= and names= are mutually exclusive\n");
+    goto fail1;
+  }
+  if (names[0] != NULL) {
+    for (inst_count = 0; inst_count < FGFDM_MAX_INSTANCES && names[inst_count] != NULL; inst_count++);
+  } else {
+    inst_count = (count > 0) ? count : 1;
+  }
+  if (inst_count > FGFDM_MAX_INSTANCES) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: too many instances (max. %d)\n", FGFDM_MAX_INSTANCES);
+    goto fail1;
+  }
+
+  for (i = 0; i < FGFDM_MAX_INSTANCES; i++) {
+    if (ports[i] < 0 || ports[i] > 65535 || (ports[i] > 0 && i >= inst_count)) {
+      rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: invalid ports entry %d for instance %d\n", ports[i], i);
+      goto fail1;
+    }
+  }
+
+  instances = fgfdm_zalloc(inst_count * sizeof(FGFDM_INST_T));
+  if (instances == NULL) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "FGFDM: unable to allocate instance memory\n");
+    goto fail1;
+  }
+  for (i = 0; i < inst_count; i++) {
+    instances[i].shmem_id = -1;
+  }
+
+  for (i = 0; i < inst_count; i++) {
+    inst = &instances[i];
+
+    // single unnamed instance keeps the plain module name
+    if (names[0] != NULL) {
+      rtapi_snprintf(inst->name, HAL_NAME_LEN, "%s", names[i]);
+    } else if (count > 0) {
+      rtapi_snprintf(inst->name, HAL_NAME_LEN, "%s.%d", FGFDM_MODULE_NAME, i);
+    } else {
+      rtapi_snprintf(inst->name, HAL_NAME_LEN, "%s", FGFDM_MODULE_NAME);
+    }
+
+    // direct mode does not need the listener segment
+    if (ports[i] > 0) {
+      if (direct_open(inst, ports[i])) {
+        goto fail2;
+      }
+      if (export_instance(inst)) {
+        goto fail2;
+      }
+      continue;
+    }
+
+    // open shmem segment
+    inst->shmem_id = rtapi_shmem_new(FGFDM_SHMEM_KEY + i, comp_id, fgfdm_shmem_size(ring_depth));
+    if (inst->shmem_id < 0) {
+      rtapi_print_msg (RTAPI_MSG_ERR, "FGFDM: couldn't allocate user/RT shared memory for %s\n", inst->name);
+      goto fail2;
+    }
+    if (fgfdm_rtapi_shmem_getptr(inst->shmem_id, (void **) &inst->shmem) < 0 ) {
+      rtapi_print_msg (RTAPI_MSG_ERR, "FGFDM: couldn't map user/RT shared memory for %s\n", inst->name);
+      goto fail2;
+    }
+    if (inst->shmem->depth != 0 && inst->shmem->depth != ring_depth) {
+      rtapi_print_msg (RTAPI_MSG_ERR, "FGFDM: ring_depth %d does not match listener ring depth %u for %s\n", ring_depth, inst->shmem->depth, inst->name);
+      goto fail2;
+    }
+    if (inst->shmem->depth == 0) {
+      rtapi_print_msg (RTAPI_MSG_WARN, "FGFDM: no listener attached to %s yet, generic protocol pins need fgfdm_lsnr to be started before fgfdm\n", inst->name);
+    }
+
+    // export pins
+    if (export_instance(inst)) {
+      goto fail2;
+    }
+  }
+
+  // export read function
+  rtapi_snprintf(name, HAL_NAME_LEN, "%s.read", FGFDM_MODULE_NAME);
+  if (profile && (prof_data = fgfdm_prof_export(comp_id, name)) == NULL) {
+    goto fail2;
+  }
+  if (hal_export_funct(name, fgfdm_read, NULL, 1, 0, comp_id)) {
+    rtapi_print_msg (RTAPI_MSG_ERR, "FGFDM: read funct export failed\n");
+    goto fail2;
+  }
+
+  // export trace function
+  if (trace_depth > 0) {
+    if (init_trace()) {
+      goto fail3;
+    }
+    rtapi_snprintf(name, HAL_NAME_LEN, "%s.trace", FGFDM_MODULE_NAME);
+    if (hal_export_funct(name, fgfdm_trace, NULL, 0, 0, comp_id)) {
+      rtapi_print_msg (RTAPI_MSG_ERR, "FGFDM: trace funct export failed\n");
+      goto fail3;
+    }
+  }
+
+  // export write function
+  if (send_values > 0) {
+    if (init_send()) {
+      goto fail4;
+    }
+    rtapi_snprintf(name, HAL_NAME_LEN, "%s.write", FGFDM_MODULE_NAME);
+    if (hal_export_funct(name, fgfdm_write, NULL, 1, 0, comp_id)) {
+      rtapi_print_msg (RTAPI_MSG_ERR, "FGFDM: write funct export failed\n");
+      goto fail4;
+    }
   }
 
   hal_ready (comp_id);
   return 0;
 
+fail4:
+  free_send();
+fail3:
+  free_trace();
 fail2:
-  rtapi_shmem_delete(shmem_id, comp_id);
+  free_instances();
 fail1:
   hal_exit(comp_id);
 fail0:
@@ -615,7 +1568,9 @@ fail0:
 }
 
 void rtapi_app_exit(void) {
-  rtapi_shmem_delete(shmem_id, comp_id);
+  free_send();
+  free_trace();
+  free_instances();
   hal_exit(comp_id);
 }
 
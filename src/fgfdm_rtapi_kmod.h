@@ -20,9 +20,12 @@
 #define _FGFDM_RTAPI_KMOD_H_
 
 #include <linux/slab.h>
+#include <linux/string.h>
 #include <linux/jiffies.h>
 #include <linux/time.h>
+#include <linux/ktime.h>
 #include <linux/sched.h>
+#include <asm/barrier.h>
 
 #define fgfdm_zalloc(size) kzalloc(size, GFP_KERNEL)
 #define fgfdm_free(ptr) kfree(ptr)
@@ -32,7 +35,15 @@
 #define FGFDM_MS_TO_TICKS(x) (HZ * x / 1000)
 #define fgfdm_get_ticks() ((long) jiffies)
 
+// CLOCK_MONOTONIC in ns, the fast accessor is safe to call from
+// RT context as it never waits for a timekeeping update
+#define fgfdm_get_time_ns() ((long long) ktime_get_mono_fast_ns())
+
 #define fgfdm_schedule() schedule()
 
+#define fgfdm_smp_wmb() smp_wmb()
+#define fgfdm_smp_rmb() smp_rmb()
+#define fgfdm_smp_mb() smp_mb()
+
 #endif
 
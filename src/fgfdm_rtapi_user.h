@@ -42,7 +42,18 @@ static inline long fgfdm_get_ticks(void) {
   return ((long)(tp.tv_sec * 1000LL)) + (tp.tv_nsec / 1000000L);
 }
 
+// monotonic time in ns, same time base as the listener receive stamps
+static inline long long fgfdm_get_time_ns(void) {
+  struct timespec tp;
+  clock_gettime(CLOCK_MONOTONIC, &tp);
+  return tp.tv_sec * 1000000000LL + tp.tv_nsec;
+}
+
 #define fgfdm_schedule() sched_yield()
 
+#define fgfdm_smp_wmb() __atomic_thread_fence(__ATOMIC_RELEASE)
+#define fgfdm_smp_rmb() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define fgfdm_smp_mb() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
 #endif
 
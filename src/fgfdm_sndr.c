@@ -0,0 +1,323 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <endian.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "fgfdm.h"
+
+// max. number of datagrams per sendmmsg call
+#define FGFDM_SNDR_BATCH_MAX 16
+
+#define FGFDM_SNDR_RATE_DEFAULT 60
+#define FGFDM_SNDR_MSG_SIZE 1024
+
+#define FGFDM_SNDR_FMT_ASCII  0
+#define FGFDM_SNDR_FMT_BINARY 1
+
+typedef struct {
+  hal_bit_t *active;
+  hal_u32_t *tx_packets;
+  hal_u32_t *tx_errors;
+  hal_u32_t *stale;
+} FGFDM_SNDR_HAL_T;
+
+static char modname[HAL_NAME_LEN + 1] = FGFDM_MODULE_NAME "_sndr";
+static int hal_comp_id;
+static FGFDM_SNDR_HAL_T *hal_data;
+
+static int sndr_sock = -1;
+static volatile sig_atomic_t exit_req = 0;
+
+static int shmem_id;
+static FGFDM_SNDR_SHMEM_T *shmem;
+
+static char msg_data[FGFDM_SNDR_BATCH_MAX][FGFDM_SNDR_MSG_SIZE];
+static struct iovec msg_iov[FGFDM_SNDR_BATCH_MAX];
+static struct mmsghdr msg_hdr[FGFDM_SNDR_BATCH_MAX];
+
+static void usage(void) {
+  fprintf(stderr, "usage: %s [options] host port\n", modname);
+  fprintf(stderr, "  -r rate   datagrams per second (default %d)\n", FGFDM_SNDR_RATE_DEFAULT);
+  fprintf(stderr, "  -b n      send n datagrams per system call (default 1, max %d)\n", FGFDM_SNDR_BATCH_MAX);
+  fprintf(stderr, "  -f fmt    generic protocol format: ascii (default) or binary\n");
+  fprintf(stderr, "  -p prio   run with SCHED_FIFO priority\n");
+  fprintf(stderr, "  -c cpu    pin sender to cpu\n");
+}
+
+// FlightGear generic protocol, ascii: comma separated values, one line
+// per datagram, binary: doubles in network byte order, returns -1 if
+// the ascii line does not fit into the datagram
+static int format_msg(char *buf, const FGFDM_SNDR_SAMPLE_T *sample, int count, int fmt) {
+  uint64_t v;
+  int i, len, ret;
+
+  if (fmt == FGFDM_SNDR_FMT_BINARY) {
+    for (i = 0; i < count; i++) {
+      memcpy(&v, &sample->value[i], sizeof(v));
+      v = htobe64(v);
+      memcpy(buf + i * sizeof(v), &v, sizeof(v));
+    }
+    return count * sizeof(v);
+  }
+
+  for (i = 0, len = 0; i <= count; i++) {
+    if (i < count) {
+      ret = snprintf(buf + len, FGFDM_SNDR_MSG_SIZE - len, (i > 0) ? ",%.6f" : "%.6f", sample->value[i]);
+    } else {
+      ret = snprintf(buf + len, FGFDM_SNDR_MSG_SIZE - len, "\n");
+    }
+    if (ret < 0 || ret >= FGFDM_SNDR_MSG_SIZE - len) {
+      return -1;
+    }
+    len += ret;
+  }
+  return len;
+}
+
+static void send_batch(int n) {
+  int sent;
+
+  sent = sendmmsg(sndr_sock, msg_hdr, n, 0);
+  if (sent < 0) {
+    sent = 0;
+  }
+  *(hal_data->tx_packets) += sent;
+  *(hal_data->tx_errors) += n - sent;
+}
+
+static int setup_sched(int prio, int cpu) {
+  struct sched_param sp;
+  cpu_set_t cpus;
+
+  if (cpu >= 0) {
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    if (sched_setaffinity(0, sizeof(cpus), &cpus)) {
+      fprintf(stderr, "%s: ERROR: unable to set cpu affinity to %d\n", modname, cpu);
+      return -1;
+    }
+  }
+
+  if (prio > 0) {
+    if (mlockall(MCL_CURRENT | MCL_FUTURE)) {
+      fprintf(stderr, "%s: WARNING: unable to lock memory\n", modname);
+    }
+    bzero(&sp, sizeof(sp));
+    sp.sched_priority = prio;
+    if (sched_setscheduler(0, SCHED_FIFO, &sp)) {
+      fprintf(stderr, "%s: ERROR: unable to set SCHED_FIFO priority %d\n", modname, prio);
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+static void exitHandler(int sig) {
+  exit_req = 1;
+}
+
+int main(int argc, char **argv) {
+  int ret = 1;
+  struct sockaddr_in sndr_addr;
+  FGFDM_SNDR_SAMPLE_T sample;
+  double rate = FGFDM_SNDR_RATE_DEFAULT;
+  int batch = 1;
+  int fmt = FGFDM_SNDR_FMT_ASCII;
+  int prio = 0;
+  int cpu = -1;
+  long long next, now, period;
+  struct timespec ts;
+  uint32_t last_frame = 0;
+  int have_frame = 0;
+  int n, i, count, len;
+  int opt;
+
+  // parse options
+  while ((opt = getopt(argc, argv, "r:b:f:p:c:")) != -1) {
+    switch (opt) {
+      case 'r':
+        rate = atof(optarg);
+        break;
+      case 'b':
+        batch = atoi(optarg);
+        break;
+      case 'f':
+        if (strcmp(optarg, "ascii") == 0) {
+          fmt = FGFDM_SNDR_FMT_ASCII;
+        } else if (strcmp(optarg, "binary") == 0) {
+          fmt = FGFDM_SNDR_FMT_BINARY;
+        } else {
+          usage();
+          goto fail0;
+        }
+        break;
+      case 'p':
+        prio = atoi(optarg);
+        break;
+      case 'c':
+        cpu = atoi(optarg);
+        break;
+      default:
+        usage();
+        goto fail0;
+    }
+  }
+  if (optind != argc - 2 || rate <= 0.0 || batch < 1 || batch > FGFDM_SNDR_BATCH_MAX) {
+    usage();
+    goto fail0;
+  }
+
+  bzero(&sndr_addr, sizeof(sndr_addr));
+  sndr_addr.sin_family = AF_INET;
+  sndr_addr.sin_port = htons(atoi(argv[optind + 1]));
+  if (inet_pton(AF_INET, argv[optind], &sndr_addr.sin_addr) != 1) {
+    fprintf(stderr, "%s: ERROR: invalid address %s\n", modname, argv[optind]);
+    goto fail0;
+  }
+
+  // initialize component
+  hal_comp_id = hal_init(modname);
+  if (hal_comp_id < 1) {
+    fprintf(stderr, "%s: ERROR: hal_init failed\n", modname);
+    goto fail0;
+  }
+
+  // allocate hal memory
+  hal_data = hal_malloc(sizeof(FGFDM_SNDR_HAL_T));
+  if (hal_data == NULL) {
+    fprintf(stderr, "%s: ERROR: unable to allocate HAL shared memory\n", modname);
+    goto fail1;
+  }
+
+  // register pins
+  if (hal_pin_bit_newf(HAL_OUT, &(hal_data->active), hal_comp_id, "%s.sndr.active", FGFDM_MODULE_NAME) != 0) {
+    fprintf(stderr, "%s: ERROR: unable to register pin %s.sndr.active\n", modname, FGFDM_MODULE_NAME);
+    goto fail1;
+  }
+  *(hal_data->active) = 0;
+
+  if (hal_pin_u32_newf(HAL_OUT, &(hal_data->tx_packets), hal_comp_id, "%s.sndr.tx-packets", FGFDM_MODULE_NAME) != 0) {
+    fprintf(stderr, "%s: ERROR: unable to register pin %s.sndr.tx-packets\n", modname, FGFDM_MODULE_NAME);
+    goto fail1;
+  }
+  *(hal_data->tx_packets) = 0;
+
+  if (hal_pin_u32_newf(HAL_OUT, &(hal_data->tx_errors), hal_comp_id, "%s.sndr.tx-errors", FGFDM_MODULE_NAME) != 0) {
+    fprintf(stderr, "%s: ERROR: unable to register pin %s.sndr.tx-errors\n", modname, FGFDM_MODULE_NAME);
+    goto fail1;
+  }
+  *(hal_data->tx_errors) = 0;
+
+  if (hal_pin_u32_newf(HAL_OUT, &(hal_data->stale), hal_comp_id, "%s.sndr.stale", FGFDM_MODULE_NAME) != 0) {
+    fprintf(stderr, "%s: ERROR: unable to register pin %s.sndr.stale\n", modname, FGFDM_MODULE_NAME);
+    goto fail1;
+  }
+  *(hal_data->stale) = 0;
+
+  // initialize signal handling
+  signal(SIGINT, exitHandler);
+  signal(SIGTERM, exitHandler);
+
+  // attach to the sample ring of fgfdm.write
+  shmem_id = rtapi_shmem_new(FGFDM_SNDR_SHMEM_KEY, hal_comp_id, sizeof(FGFDM_SNDR_SHMEM_T));
+  if (shmem_id < 0) {
+    fprintf(stderr, "%s: ERROR: couldn't allocate user/RT shared memory\n", modname);
+    goto fail1;
+  }
+  if (fgfdm_rtapi_shmem_getptr(shmem_id, (void **) &shmem)) {
+    fprintf(stderr, "%s: ERROR: couldn't map user/RT shared memory\n", modname);
+    goto fail3;
+  }
+
+  // create socket
+  sndr_sock = socket(AF_INET, SOCK_DGRAM, 0);
+  if (sndr_sock < 0) {
+    fprintf(stderr, "%s: ERROR: unable to create UDP socket\n", modname);
+    goto fail3;
+  }
+
+  // all datagrams of a batch go to the same address
+  for (i = 0; i < FGFDM_SNDR_BATCH_MAX; i++) {
+    msg_iov[i].iov_base = msg_data[i];
+    bzero(&msg_hdr[i], sizeof(struct mmsghdr));
+    msg_hdr[i].msg_hdr.msg_name = &sndr_addr;
+    msg_hdr[i].msg_hdr.msg_namelen = sizeof(sndr_addr);
+    msg_hdr[i].msg_hdr.msg_iov = &msg_iov[i];
+    msg_hdr[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  // setup scheduling
+  if (setup_sched(prio, cpu)) {
+    goto fail4;
+  }
+
+  // everything is fine
+  ret = 0;
+  hal_ready(hal_comp_id);
+
+  period = (long long) (1e9 / rate);
+  next = fgfdm_get_time_ns();
+  n = 0;
+  while (!exit_req) {
+    // do not catch up missed periods
+    next += period;
+    now = fgfdm_get_time_ns();
+    if (next < now) {
+      next = now;
+    }
+    ts.tv_sec = next / 1000000000LL;
+    ts.tv_nsec = next % 1000000000LL;
+    if (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+      continue;
+    }
+
+    // wait for fgfdm.write, skip samples already sent
+    count = shmem->count;
+    if (count <= 0 || count > FGFDM_SNDR_MAX_VALUES || fgfdm_sndr_read_latest(shmem, &sample)) {
+      *(hal_data->active) = 0;
+      continue;
+    }
+    if (have_frame && sample.frame == last_frame) {
+      *(hal_data->active) = 0;
+      (*(hal_data->stale))++;
+      continue;
+    }
+    last_frame = sample.frame;
+    have_frame = 1;
+    *(hal_data->active) = 1;
+
+    // drop samples with values too long for an ascii datagram
+    len = format_msg(msg_data[n], &sample, count, fmt);
+    if (len < 0) {
+      (*(hal_data->tx_errors))++;
+      continue;
+    }
+    msg_iov[n].iov_len = len;
+    if (++n >= batch) {
+      send_batch(n);
+      n = 0;
+    }
+  }
+  if (n > 0) {
+    send_batch(n);
+  }
+
+fail4:
+  close(sndr_sock);
+fail3:
+  rtapi_shmem_delete(shmem_id, hal_comp_id);
+fail1:
+  hal_exit(hal_comp_id);
+fail0:
+  return ret;
+}
@@ -0,0 +1,316 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <signal.h>
+
+#include "fgfdm.h"
+
+// trace file header, followed by the raw records
+#define FGFDM_TRACE_MAGIC "FGTR"
+#define FGFDM_TRACE_VERSION 1
+
+// default drain interval in ms
+#define FGFDM_TRACE_POLL_DEFAULT 10
+
+typedef struct {
+  char magic[4];
+  uint32_t version;
+  uint32_t rec_size;
+  uint32_t reserved;
+} FGFDM_TRACE_FILE_HDR_T;
+
+typedef struct {
+  const char *name;
+  int from;
+  int to;
+} FGFDM_TRACE_STAGE_T;
+
+// offsets into the record time stamps
+#define STAGE_RX   0
+#define STAGE_PUB  1
+#define STAGE_READ 2
+#define STAGE_OUT  3
+
+static const FGFDM_TRACE_STAGE_T stages[] = {
+  { "rx-pub",   STAGE_RX,   STAGE_PUB  },
+  { "pub-read", STAGE_PUB,  STAGE_READ },
+  { "read-out", STAGE_READ, STAGE_OUT  },
+  { "rx-read",  STAGE_RX,   STAGE_READ },
+  { "rx-out",   STAGE_RX,   STAGE_OUT  },
+  { NULL }
+};
+
+static const double percentiles[] = { 50.0, 90.0, 99.0, 99.9 };
+#define PERCENTILE_COUNT (sizeof(percentiles) / sizeof(percentiles[0]))
+
+static const char *modname = "fgfdm_trace";
+
+static volatile sig_atomic_t exit_req = 0;
+
+static void usage(void) {
+  fprintf(stderr, "usage: %s record [-d depth] [-p ms] file\n", modname);
+  fprintf(stderr, "       %s report [-i index] file\n", modname);
+  fprintf(stderr, "  -d depth  trace ring depth, must match fgfdm trace_depth= (default %d)\n", FGFDM_TRACE_DEPTH_DEFAULT);
+  fprintf(stderr, "  -p ms     drain interval (default %d)\n", FGFDM_TRACE_POLL_DEFAULT);
+  fprintf(stderr, "  -i index  only report the given feed instance\n");
+}
+
+static void exitHandler(int sig) {
+  exit_req = 1;
+}
+
+static uint64_t rec_time(const FGFDM_TRACE_REC_T *rec, int stage) {
+  switch (stage) {
+    case STAGE_RX:
+      return rec->rx_time;
+    case STAGE_PUB:
+      return rec->pub_time;
+    case STAGE_READ:
+      return rec->read_time;
+    default:
+      return rec->out_time;
+  }
+}
+
+// drain the RT trace ring into a file until interrupted
+static int trace_record(int argc, char **argv) {
+  int ret = 1;
+  int depth = FGFDM_TRACE_DEPTH_DEFAULT;
+  int poll_ms = FGFDM_TRACE_POLL_DEFAULT;
+  int comp_id, shmem_id;
+  FGFDM_TRACE_T *trace;
+  FGFDM_TRACE_REC_T rec;
+  FGFDM_TRACE_FILE_HDR_T hdr;
+  FILE *f;
+  unsigned long records = 0;
+  uint32_t dropped;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "d:p:")) != -1) {
+    switch (opt) {
+      case 'd':
+        depth = atoi(optarg);
+        break;
+      case 'p':
+        poll_ms = atoi(optarg);
+        break;
+      default:
+        usage();
+        goto fail0;
+    }
+  }
+  if (optind != argc - 1) {
+    usage();
+    goto fail0;
+  }
+  if (!fgfdm_trace_depth_valid(depth)) {
+    fprintf(stderr, "%s: ERROR: invalid trace depth %d (must be a power of two between 2 and %d)\n", modname, depth, FGFDM_TRACE_DEPTH_MAX);
+    goto fail0;
+  }
+
+  // initialize component
+  comp_id = hal_init(modname);
+  if (comp_id < 1) {
+    fprintf(stderr, "%s: ERROR: hal_init failed\n", modname);
+    goto fail0;
+  }
+
+  // attach to the trace ring
+  shmem_id = rtapi_shmem_new(FGFDM_TRACE_SHMEM_KEY, comp_id, fgfdm_trace_size(depth));
+  if (shmem_id < 0) {
+    fprintf(stderr, "%s: ERROR: couldn't allocate trace shared memory\n", modname);
+    goto fail1;
+  }
+  if (fgfdm_rtapi_shmem_getptr(shmem_id, (void **) &trace)) {
+    fprintf(stderr, "%s: ERROR: couldn't map trace shared memory\n", modname);
+    goto fail2;
+  }
+  if (trace->depth == 0) {
+    trace->depth = depth;
+  }
+  if (trace->depth != depth) {
+    fprintf(stderr, "%s: ERROR: trace depth %d does not match trace ring depth %u\n", modname, depth, trace->depth);
+    goto fail2;
+  }
+
+  // discard records of an earlier run
+  trace->tail = trace->head;
+  dropped = trace->dropped;
+
+  f = fopen(argv[optind], "wb");
+  if (f == NULL) {
+    fprintf(stderr, "%s: ERROR: unable to create %s\n", modname, argv[optind]);
+    goto fail2;
+  }
+  memcpy(hdr.magic, FGFDM_TRACE_MAGIC, sizeof(hdr.magic));
+  hdr.version = FGFDM_TRACE_VERSION;
+  hdr.rec_size = sizeof(FGFDM_TRACE_REC_T);
+  hdr.reserved = 0;
+  if (fwrite(&hdr, sizeof(hdr), 1, f) != 1) {
+    fprintf(stderr, "%s: ERROR: unable to write %s\n", modname, argv[optind]);
+    goto fail3;
+  }
+
+  signal(SIGINT, exitHandler);
+  signal(SIGTERM, exitHandler);
+
+  hal_ready(comp_id);
+
+  ret = 0;
+  while (!exit_req) {
+    while (!fgfdm_trace_get(trace, &rec)) {
+      if (fwrite(&rec, sizeof(rec), 1, f) != 1) {
+        fprintf(stderr, "%s: ERROR: unable to write %s\n", modname, argv[optind]);
+        ret = 1;
+        goto fail3;
+      }
+      records++;
+    }
+    usleep(poll_ms * 1000);
+  }
+
+  fprintf(stderr, "%s: %lu records written, %u dropped\n", modname, records, trace->dropped - dropped);
+
+fail3:
+  fclose(f);
+fail2:
+  rtapi_shmem_delete(shmem_id, comp_id);
+fail1:
+  hal_exit(comp_id);
+fail0:
+  return ret;
+}
+
+static int cmp_ll(const void *a, const void *b) {
+  long long x = *(const long long *) a;
+  long long y = *(const long long *) b;
+  return (x > y) - (x < y);
+}
+
+// print latency percentiles of every stage of a trace file
+static int trace_report(int argc, char **argv) {
+  int ret = 1;
+  int instance = -1;
+  FGFDM_TRACE_FILE_HDR_T hdr;
+  FGFDM_TRACE_REC_T *recs = NULL, *p;
+  const FGFDM_TRACE_STAGE_T *stage;
+  long long *lat = NULL;
+  size_t count, alloc, n, i, k;
+  uint64_t from, to;
+  char label[16];
+  FILE *f;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "i:")) != -1) {
+    switch (opt) {
+      case 'i':
+        instance = atoi(optarg);
+        break;
+      default:
+        usage();
+        goto fail0;
+    }
+  }
+  if (optind != argc - 1) {
+    usage();
+    goto fail0;
+  }
+
+  f = fopen(argv[optind], "rb");
+  if (f == NULL) {
+    fprintf(stderr, "%s: ERROR: unable to open %s\n", modname, argv[optind]);
+    goto fail0;
+  }
+  if (fread(&hdr, sizeof(hdr), 1, f) != 1 || memcmp(hdr.magic, FGFDM_TRACE_MAGIC, sizeof(hdr.magic)) ||
+      hdr.version != FGFDM_TRACE_VERSION || hdr.rec_size != sizeof(FGFDM_TRACE_REC_T)) {
+    fprintf(stderr, "%s: ERROR: %s is not a trace file\n", modname, argv[optind]);
+    goto fail1;
+  }
+
+  // load records of the selected instance
+  count = 0;
+  alloc = 0;
+  while (1) {
+    if (count == alloc) {
+      alloc = alloc ? 2 * alloc : 4096;
+      p = realloc(recs, alloc * sizeof(FGFDM_TRACE_REC_T));
+      if (p == NULL) {
+        fprintf(stderr, "%s: ERROR: out of memory\n", modname);
+        goto fail2;
+      }
+      recs = p;
+    }
+    if (fread(&recs[count], sizeof(FGFDM_TRACE_REC_T), 1, f) != 1) {
+      break;
+    }
+    if (instance < 0 || recs[count].instance == instance) {
+      count++;
+    }
+  }
+
+  lat = malloc((count + 1) * sizeof(long long));
+  if (lat == NULL) {
+    fprintf(stderr, "%s: ERROR: out of memory\n", modname);
+    goto fail2;
+  }
+
+  printf("%lu records, latency in us\n", (unsigned long) count);
+  printf("%-10s %8s %9s", "stage", "count", "min");
+  for (k = 0; k < PERCENTILE_COUNT; k++) {
+    snprintf(label, sizeof(label), "p%g", percentiles[k]);
+    printf(" %9s", label);
+  }
+  printf(" %9s\n", "max");
+
+  for (stage = stages; stage->name != NULL; stage++) {
+    // records without receive stamp (listener timeouts) are skipped
+    for (i = 0, n = 0; i < count; i++) {
+      from = rec_time(&recs[i], stage->from);
+      to = rec_time(&recs[i], stage->to);
+      if (recs[i].rx_time == 0 || from == 0 || to == 0) {
+        continue;
+      }
+      lat[n++] = (long long) (to - from);
+    }
+
+    printf("%-10s %8lu", stage->name, (unsigned long) n);
+    if (n == 0) {
+      printf("\n");
+      continue;
+    }
+
+    qsort(lat, n, sizeof(long long), cmp_ll);
+    printf(" %9.1f", lat[0] * 0.001);
+    for (k = 0; k < PERCENTILE_COUNT; k++) {
+      printf(" %9.1f", lat[(size_t) ((n - 1) * percentiles[k] / 100.0 + 0.5)] * 0.001);
+    }
+    printf(" %9.1f\n", lat[n - 1] * 0.001);
+  }
+
+  ret = 0;
+
+fail2:
+  free(lat);
+  free(recs);
+fail1:
+  fclose(f);
+fail0:
+  return ret;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    usage();
+    return 1;
+  }
+
+  if (strcmp(argv[1], "record") == 0) {
+    return trace_record(argc - 1, argv + 1);
+  }
+  if (strcmp(argv[1], "report") == 0) {
+    return trace_report(argc - 1, argv + 1);
+  }
+
+  usage();
+  return 1;
+}
@@ -1,115 +1,507 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
 #include <arpa/inet.h>
 
 #include "net_fdm.h"
 
+// Field layout of FGNetFDM. Every field is a 4 byte integer/float or an
+// 8 byte double (or an array of them), so decoding only needs to reverse
+// the bytes of each element. The table is translated once into a byte
+// shuffle pattern that is applied to the whole struct.
+
+typedef struct {
+    uint16_t offset;
+    uint16_t size;
+    uint16_t count;
+} FGNetFDMField;
+
+#define FDM_FIELD(name, type) \
+    { offsetof(FGNetFDM, name), sizeof(type), sizeof(((FGNetFDM *) 0)->name) / sizeof(type) }
+
+static const FGNetFDMField fdm_fields[] = {
+    FDM_FIELD(version, uint32_t),
+    FDM_FIELD(padding, uint32_t),
+
+    FDM_FIELD(longitude, double),
+    FDM_FIELD(latitude, double),
+    FDM_FIELD(altitude, double),
+    FDM_FIELD(agl, float),
+    FDM_FIELD(phi, float),
+    FDM_FIELD(theta, float),
+    FDM_FIELD(psi, float),
+    FDM_FIELD(alpha, float),
+    FDM_FIELD(beta, float),
+
+    FDM_FIELD(phidot, float),
+    FDM_FIELD(thetadot, float),
+    FDM_FIELD(psidot, float),
+    FDM_FIELD(vcas, float),
+    FDM_FIELD(climb_rate, float),
+    FDM_FIELD(v_north, float),
+    FDM_FIELD(v_east, float),
+    FDM_FIELD(v_down, float),
+    FDM_FIELD(v_body_u, float),
+    FDM_FIELD(v_body_v, float),
+    FDM_FIELD(v_body_w, float),
+
+    FDM_FIELD(A_X_pilot, float),
+    FDM_FIELD(A_Y_pilot, float),
+    FDM_FIELD(A_Z_pilot, float),
+
+    FDM_FIELD(stall_warning, float),
+    FDM_FIELD(slip_deg, float),
+
+    FDM_FIELD(num_engines, uint32_t),
+    FDM_FIELD(eng_state, uint32_t),
+    FDM_FIELD(rpm, float),
+    FDM_FIELD(fuel_flow, float),
+    FDM_FIELD(fuel_px, float),
+    FDM_FIELD(egt, float),
+    FDM_FIELD(cht, float),
+    FDM_FIELD(mp_osi, float),
+    FDM_FIELD(tit, float),
+    FDM_FIELD(oil_temp, float),
+    FDM_FIELD(oil_px, float),
+
+    FDM_FIELD(num_tanks, uint32_t),
+    FDM_FIELD(fuel_quantity, float),
+
+    FDM_FIELD(num_wheels, uint32_t),
+    FDM_FIELD(wow, uint32_t),
+    FDM_FIELD(gear_pos, float),
+    FDM_FIELD(gear_steer, float),
+    FDM_FIELD(gear_compression, float),
+
+    FDM_FIELD(cur_time, uint32_t),
+    FDM_FIELD(warp, int32_t),
+    FDM_FIELD(visibility, float),
+
+    FDM_FIELD(elevator, float),
+    FDM_FIELD(elevator_trim_tab, float),
+    FDM_FIELD(left_flap, float),
+    FDM_FIELD(right_flap, float),
+    FDM_FIELD(left_aileron, float),
+    FDM_FIELD(right_aileron, float),
+    FDM_FIELD(rudder, float),
+    FDM_FIELD(nose_wheel, float),
+    FDM_FIELD(speedbrake, float),
+    FDM_FIELD(spoilers, float),
+};
+
+#define FDM_FIELD_COUNT (sizeof(fdm_fields) / sizeof(fdm_fields[0]))
+
+// Supported wire versions. A version lists its fields in wire order,
+// offset is the FGNetFDM field the values are decoded into (FDM_SKIP
+// for fields FGNetFDM does not have) and count the number of elements
+// on the wire. Wire offsets follow the natural alignment of the C
+// struct FlightGear sends, so a new simulator version only needs a new
+// table here, the realtime module always sees FGNetFDM. The native
+// version is swapped in place by the byte shuffle, all others are
+// decoded by a copy list compiled from their table.
+
+#define FDM_SKIP 0xffff
+
+#define FDM_WIRE(name, type, n) { offsetof(FGNetFDM, name), sizeof(type), n }
+#define FDM_WIRE_SKIP(type, n) { FDM_SKIP, sizeof(type), n }
+
+typedef struct {
+    uint32_t version;
+    const FGNetFDMField *fields;
+    int count;
+} FGNetFDMVersion;
+
+static const FGNetFDMVersion fdm_versions[] = {
+    { FG_NET_FDM_VERSION, fdm_fields, FDM_FIELD_COUNT },
+};
+
+#define FDM_VERSION_COUNT (sizeof(fdm_versions) / sizeof(fdm_versions[0]))
+
+// one swap and copy run of elements of the same size
+typedef struct {
+    uint16_t wire;
+    uint16_t host;
+    uint16_t size;
+    uint16_t count;
+} FGNetFDMCopy;
+
+typedef struct {
+    uint32_t version;
+    uint32_t size;
+    int ncopy;
+    FGNetFDMCopy copy[FDM_FIELD_COUNT];
+} FGNetFDMDecoder;
+
+static FGNetFDMDecoder fdm_decoders[FDM_VERSION_COUNT];
+static int fdm_decoder_count;
+static char fdm_version_str[64];
+
+// shuffle pattern in 16 byte lanes (index relative to lane start)
+#define FDM_LANES ((sizeof(FGNetFDM) + 15) / 16)
+static uint8_t fdm_shuffle[FDM_LANES * 16] __attribute__((aligned(32)));
+
+static void clamp_counts(FGNetFDM *net) {
+    // never trust array sizes from the wire
+    if (net->num_engines > FG_MAX_ENGINES) {
+        net->num_engines = FG_MAX_ENGINES;
+    }
+    if (net->num_tanks > FG_MAX_TANKS) {
+        net->num_tanks = FG_MAX_TANKS;
+    }
+    if (net->num_wheels > FG_MAX_WHEELS) {
+        net->num_wheels = FG_MAX_WHEELS;
+    }
+}
+
 #if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
 
-// The function ntohd is defined this way due to the way some
-// processors and OSes treat floating point values.  Some will raise
-// an exception whenever a "bad" floating point value is loaded into a
-// floating point register.  Solaris is notorious for this, but then
-// so is LynxOS on the PowerPC.  By translating the data in place,
-// there is no need to load a FP register with the "corruped" floating
-// point value.  By doing the BIG_ENDIAN test, I can optimize the
-// routine for big-endian processors so it can be as efficient as
-// possible
-void ntohd(double *x) {
-    uint32_t *ovl = (uint32_t *) x;
-    uint32_t tmp;
+// Elements are swapped through integer registers only. Some platforms
+// raise an exception whenever a "bad" floating point value is loaded
+// into a floating point register, so byte swapped values must never be
+// accessed as float/double.
+static void swap_scalar(uint8_t *p) {
+    const FGNetFDMField *f;
+    uint32_t v32;
+    uint64_t v64;
+    int i, k;
 
-    tmp = ovl[0];
-    ovl[0] = ntohl(ovl[1]);
-    ovl[1] = ntohl(tmp);
+    for (i = 0, f = fdm_fields; i < FDM_FIELD_COUNT; i++, f++) {
+        uint8_t *e = p + f->offset;
+        if (f->size == 8) {
+            for (k = 0; k < f->count; k++, e += 8) {
+                memcpy(&v64, e, 8);
+                v64 = __builtin_bswap64(v64);
+                memcpy(e, &v64, 8);
+            }
+        } else {
+            for (k = 0; k < f->count; k++, e += 4) {
+                memcpy(&v32, e, 4);
+                v32 = __builtin_bswap32(v32);
+                memcpy(e, &v32, 4);
+            }
+        }
+    }
 }
 
-// float version
-void ntohf(float *x)	{
-    uint32_t *ovl = (uint32_t *) x;
-    *ovl = ntohl(*ovl);
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+__attribute__((target("ssse3")))
+static void swap_ssse3(uint8_t *p) {
+    uint8_t tail[16];
+    size_t off, rem;
+
+    for (off = 0; off + 16 <= sizeof(FGNetFDM); off += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (p + off));
+        __m128i m = _mm_load_si128((const __m128i *) (fdm_shuffle + off));
+        _mm_storeu_si128((__m128i *) (p + off), _mm_shuffle_epi8(v, m));
+    }
+
+    rem = sizeof(FGNetFDM) - off;
+    if (rem > 0) {
+        memcpy(tail, p + off, rem);
+        __m128i v = _mm_loadu_si128((const __m128i *) tail);
+        __m128i m = _mm_load_si128((const __m128i *) (fdm_shuffle + off));
+        _mm_storeu_si128((__m128i *) tail, _mm_shuffle_epi8(v, m));
+        memcpy(p + off, tail, rem);
+    }
 }
 
-void ntohfdm(FGNetFDM *net) {
+__attribute__((target("avx2")))
+static void swap_avx2(uint8_t *p) {
+    uint8_t tail[16];
+    size_t off, rem;
+
+    for (off = 0; off + 32 <= sizeof(FGNetFDM); off += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *) (p + off));
+        __m256i m = _mm256_load_si256((const __m256i *) (fdm_shuffle + off));
+        _mm256_storeu_si256((__m256i *) (p + off), _mm256_shuffle_epi8(v, m));
+    }
+
+    for (; off + 16 <= sizeof(FGNetFDM); off += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (p + off));
+        __m128i m = _mm_load_si128((const __m128i *) (fdm_shuffle + off));
+        _mm_storeu_si128((__m128i *) (p + off), _mm_shuffle_epi8(v, m));
+    }
+
+    rem = sizeof(FGNetFDM) - off;
+    if (rem > 0) {
+        memcpy(tail, p + off, rem);
+        __m128i v = _mm_loadu_si128((const __m128i *) tail);
+        __m128i m = _mm_load_si128((const __m128i *) (fdm_shuffle + off));
+        _mm_storeu_si128((__m128i *) tail, _mm_shuffle_epi8(v, m));
+        memcpy(p + off, tail, rem);
+    }
+}
+#define HAVE_SIMD_SWAP
+#endif
+
+static const struct {
+    const char *name;
+    void (*swap)(uint8_t *p);
+} swap_impls[] = {
+#ifdef HAVE_SIMD_SWAP
+    { "avx2", swap_avx2 },
+    { "ssse3", swap_ssse3 },
+#endif
+    { "scalar", swap_scalar },
+};
+
+#define SWAP_IMPL_COUNT (sizeof(swap_impls) / sizeof(swap_impls[0]))
+
+static int swap_impl = SWAP_IMPL_COUNT - 1;
+
+static int swap_impl_supported(int idx) {
+#ifdef HAVE_SIMD_SWAP
+    __builtin_cpu_init();
+    if (swap_impls[idx].swap == swap_avx2) {
+        return __builtin_cpu_supports("avx2");
+    }
+    if (swap_impls[idx].swap == swap_ssse3) {
+        return __builtin_cpu_supports("ssse3");
+    }
+#endif
+    return 1;
+}
+
+static void swap_init(void) {
+    const FGNetFDMField *f;
+    int i, k, b, off;
+
+    // identity for padding bytes behind the struct
+    for (i = 0; i < sizeof(fdm_shuffle); i++) {
+        fdm_shuffle[i] = i & 15;
+    }
+
+    // reverse bytes of every element
+    for (i = 0, f = fdm_fields; i < FDM_FIELD_COUNT; i++, f++) {
+        for (k = 0; k < f->count; k++) {
+            off = f->offset + k * f->size;
+            for (b = 0; b < f->size; b++) {
+                fdm_shuffle[off + b] = (off + f->size - 1 - b) & 15;
+            }
+        }
+    }
+
+    // select fastest supported implementation
+    for (i = 0; i < SWAP_IMPL_COUNT; i++) {
+        if (swap_impl_supported(i)) {
+            swap_impl = i;
+            break;
+        }
+    }
+}
+
+int ntohfdm_select(const char *name) {
     int i;
 
-    // Convert to the net buffer from network format
-    net->version = ntohl(net->version);
-
-    ntohd(&net->longitude);
-    ntohd(&net->latitude);
-    ntohd(&net->altitude);
-    ntohf(&net->agl);
-    ntohf(&net->phi);
-    ntohf(&net->theta);
-    ntohf(&net->psi);
-    ntohf(&net->alpha);
-    ntohf(&net->beta);
-
-    ntohf(&net->phidot);
-    ntohf(&net->thetadot);
-    ntohf(&net->psidot);
-    ntohf(&net->vcas);
-    ntohf(&net->climb_rate);
-    ntohf(&net->v_north);
-    ntohf(&net->v_east);
-    ntohf(&net->v_down);
-    ntohf(&net->v_body_u);
-    ntohf(&net->v_body_v);
-    ntohf(&net->v_body_w);
-
-    ntohf(&net->A_X_pilot);
-    ntohf(&net->A_Y_pilot);
-    ntohf(&net->A_Z_pilot);
-
-    ntohf(&net->stall_warning);
-    ntohf(&net->slip_deg);
-
-    net->num_engines = ntohl(net->num_engines);
-    for ( i = 0; i < net->num_engines; ++i ) {
-        net->eng_state[i] = ntohl(net->eng_state[i]);
-        ntohf(&net->rpm[i]);
-        ntohf(&net->fuel_flow[i]);
-        ntohf(&net->fuel_px[i]);
-        ntohf(&net->egt[i]);
-        ntohf(&net->cht[i]);
-        ntohf(&net->mp_osi[i]);
-        ntohf(&net->tit[i]);
-        ntohf(&net->oil_temp[i]);
-        ntohf(&net->oil_px[i]);
-    }
-
-    net->num_tanks = ntohl(net->num_tanks);
-    for ( i = 0; i < net->num_tanks; ++i ) {
-        ntohf(&net->fuel_quantity[i]);
-    }
-
-    net->num_wheels = ntohl(net->num_wheels);
-    for ( i = 0; i < net->num_wheels; ++i ) {
-        net->wow[i] = ntohl(net->wow[i]);
-        ntohf(&net->gear_pos[i]);
-        ntohf(&net->gear_steer[i]);
-        ntohf(&net->gear_compression[i]);
-    }
-
-    net->cur_time = ntohl(net->cur_time);
-    net->warp = ntohl(net->warp);
-    ntohf(&net->visibility);
-
-    ntohf(&net->elevator);
-    ntohf(&net->elevator_trim_tab);
-    ntohf(&net->left_flap);
-    ntohf(&net->right_flap);
-    ntohf(&net->left_aileron);
-    ntohf(&net->right_aileron);
-    ntohf(&net->rudder);
-    ntohf(&net->nose_wheel);
-    ntohf(&net->speedbrake);
-    ntohf(&net->spoilers);
+    for (i = 0; i < SWAP_IMPL_COUNT; i++) {
+        if (strcmp(swap_impls[i].name, name) == 0 && swap_impl_supported(i)) {
+            swap_impl = i;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+const char *ntohfdm_impl(void) {
+    return swap_impls[swap_impl].name;
+}
+
+void ntohfdm(FGNetFDM *net) {
+    swap_impls[swap_impl].swap((uint8_t *) net);
+    clamp_counts(net);
+}
+
+void htonfdm(FGNetFDM *net) {
+    swap_impls[swap_impl].swap((uint8_t *) net);
 }
 
+#define FDM_BSWAP32(v) __builtin_bswap32(v)
+#define FDM_BSWAP64(v) __builtin_bswap64(v)
+
 #else
 
+static void swap_init(void) {
+}
+
+int ntohfdm_select(const char *name) {
+    return strcmp(name, "none") == 0 ? 0 : -1;
+}
+
+const char *ntohfdm_impl(void) {
+    return "none";
+}
+
 void ntohfdm(FGNetFDM *net) {
+    clamp_counts(net);
+}
+
+void htonfdm(FGNetFDM *net) {
 }
 
+#define FDM_BSWAP32(v) (v)
+#define FDM_BSWAP64(v) (v)
+
 #endif
 
+// element count of a FGNetFDM field
+static int host_count(uint16_t offset) {
+    int i;
+
+    for (i = 0; i < FDM_FIELD_COUNT; i++) {
+        if (fdm_fields[i].offset == offset) {
+            return fdm_fields[i].count;
+        }
+    }
+    return 0;
+}
+
+static int compile_decoder(const FGNetFDMVersion *v, FGNetFDMDecoder *d) {
+    const FGNetFDMField *f;
+    FGNetFDMCopy *c;
+    int i, n, wire, align;
+
+    d->version = v->version;
+    d->ncopy = 0;
+    wire = 0;
+    align = 4;
+    for (i = 0, f = v->fields; i < v->count; i++, f++) {
+        wire = (wire + f->size - 1) & ~(f->size - 1);
+        if (f->size > align) {
+            align = f->size;
+        }
+
+        // arrays larger than in FGNetFDM are cut
+        n = (f->offset == FDM_SKIP) ? 0 : host_count(f->offset);
+        if (n > f->count) {
+            n = f->count;
+        }
+        if (n > 0) {
+            // extend the previous run if both sides are contiguous
+            c = (d->ncopy > 0) ? &d->copy[d->ncopy - 1] : NULL;
+            if (c != NULL && c->size == f->size &&
+                c->wire + c->count * c->size == wire && c->host + c->count * c->size == f->offset) {
+                c->count += n;
+            } else {
+                if (d->ncopy >= FDM_FIELD_COUNT) {
+                    return -1;
+                }
+                c = &d->copy[d->ncopy++];
+                c->wire = wire;
+                c->host = f->offset;
+                c->size = f->size;
+                c->count = n;
+            }
+        }
+
+        wire += f->size * f->count;
+    }
+
+    d->size = (wire + align - 1) & ~(align - 1);
+    return (d->size <= FG_NET_FDM_WIRE_MAX) ? 0 : -1;
+}
+
+static const FGNetFDMDecoder *find_decoder(uint32_t version) {
+    int i;
+
+    for (i = 0; i < fdm_decoder_count; i++) {
+        if (fdm_decoders[i].version == version) {
+            return &fdm_decoders[i];
+        }
+    }
+    return NULL;
+}
+
+// Elements go through integer registers only, see swap_scalar
+static void decode_copy(const FGNetFDMDecoder *d, const uint8_t *wire, FGNetFDM *net) {
+    const FGNetFDMCopy *c;
+    uint8_t *host = (uint8_t *) net;
+    uint32_t v32;
+    uint64_t v64;
+    int i, k;
+
+    // fields missing in the wire version stay zero
+    memset(net, 0, sizeof(FGNetFDM));
+    for (i = 0, c = d->copy; i < d->ncopy; i++, c++) {
+        if (c->size == 8) {
+            for (k = 0; k < c->count; k++) {
+                memcpy(&v64, wire + c->wire + k * 8, 8);
+                v64 = FDM_BSWAP64(v64);
+                memcpy(host + c->host + k * 8, &v64, 8);
+            }
+        } else {
+            for (k = 0; k < c->count; k++) {
+                memcpy(&v32, wire + c->wire + k * 4, 4);
+                v32 = FDM_BSWAP32(v32);
+                memcpy(host + c->host + k * 4, &v32, 4);
+            }
+        }
+    }
+}
+
+void ntohfdm_init(void) {
+    int i, len;
+
+    swap_init();
+
+    // versions with a broken table are left out
+    fdm_decoder_count = 0;
+    len = 0;
+    for (i = 0; i < FDM_VERSION_COUNT; i++) {
+        if (compile_decoder(&fdm_versions[i], &fdm_decoders[fdm_decoder_count])) {
+            continue;
+        }
+        len += snprintf(fdm_version_str + len, sizeof(fdm_version_str) - len,
+            (fdm_decoder_count > 0) ? ", %u" : "%u", fdm_versions[i].version);
+        fdm_decoder_count++;
+    }
+}
+
+int ntohfdm_any(FGNetFDM *net, const void *tail, unsigned int len) {
+    uint8_t wire[FG_NET_FDM_WIRE_MAX];
+    const FGNetFDMDecoder *d;
+    uint32_t version;
+
+    memcpy(&version, net, sizeof(version));
+    d = find_decoder(ntohl(version));
+    if (d == NULL) {
+        return FG_NET_FDM_ERR_VERSION;
+    }
+    if (len != d->size) {
+        return FG_NET_FDM_ERR_SIZE;
+    }
+
+    // native version is swapped in place
+    if (d->version == FG_NET_FDM_VERSION) {
+        ntohfdm(net);
+        return 0;
+    }
+
+    // the decoder writes net, so gather the datagram first
+    if (len <= sizeof(FGNetFDM)) {
+        memcpy(wire, net, len);
+    } else {
+        memcpy(wire, net, sizeof(FGNetFDM));
+        memcpy(wire + sizeof(FGNetFDM), tail, len - sizeof(FGNetFDM));
+    }
+    decode_copy(d, wire, net);
+    clamp_counts(net);
+    return 0;
+}
+
+int ntohfdm_size_valid(unsigned int len) {
+    int i;
+
+    for (i = 0; i < fdm_decoder_count; i++) {
+        if (fdm_decoders[i].size == len) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+const char *ntohfdm_versions(void) {
+    return fdm_version_str;
+}
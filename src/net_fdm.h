@@ -111,7 +111,29 @@ typedef struct {
     float spoilers;
 } FGNetFDM;
 
+// max. datagram size of all supported wire versions
+#define FG_NET_FDM_WIRE_MAX 1024
+
+// ntohfdm_any() results
+#define FG_NET_FDM_ERR_VERSION -1
+#define FG_NET_FDM_ERR_SIZE    -2
+
+// build decoder tables and select the fastest byte swap implementation
+extern void ntohfdm_init(void);
+// force a byte swap implementation ("avx2", "ssse3", "scalar"), 0 on success
+extern int ntohfdm_select(const char *name);
+extern const char *ntohfdm_impl(void);
+// convert from network byte order in place, clamps the array counts
 extern void ntohfdm(FGNetFDM *net);
+// convert to network byte order in place (for senders and test tools)
+extern void htonfdm(FGNetFDM *net);
+// decode a datagram of any supported wire version into net, which holds
+// the first sizeof(FGNetFDM) bytes of it, tail holds the rest
+extern int ntohfdm_any(FGNetFDM *net, const void *tail, unsigned int len);
+// 1 if len is the datagram size of a supported version
+extern int ntohfdm_size_valid(unsigned int len);
+// supported wire versions as text (e.g. "24")
+extern const char *ntohfdm_versions(void);
 
 #endif // _NET_FDM_H
 
@@ -23,9 +23,15 @@ module = $(patsubst %.o,%.so,$(obj-m))
 
 EXTRA_CFLAGS := $(filter-out -Wframe-larger-than=%,$(EXTRA_CFLAGS))
 
+# decoder for the direct socket mode of fgfdm.read
+fgfdm-objs += net_fdm_rt.o
+
 $(module): $(fgfdm-objs)
 	$(CC) -shared -o $@ $(fgfdm-objs) -Wl,-rpath,$(LIBDIR) -L$(LIBDIR) -llinuxcnchal -lrt
 
+net_fdm_rt.o: net_fdm.c
+	$(CC) -o $@ $(EXTRA_CFLAGS) -Os -c $<
+
 %.o: %.c
 	$(CC) -o $@ $(EXTRA_CFLAGS) -Os -c $<
 
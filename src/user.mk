@@ -4,14 +4,30 @@ EXTRA_CFLAGS := $(filter-out -Wframe-larger-than=%,$(EXTRA_CFLAGS))
 
 .PHONY: all clean install
 
-all: fgfdm_lsnr
+all: fgfdm_lsnr fgfdm_sndr fgfdm_bench fgfdm_trace fgfdm_gen
 
-install: fgfdm_lsnr
+install: fgfdm_lsnr fgfdm_sndr fgfdm_bench fgfdm_trace fgfdm_gen
 	mkdir -p $(DESTDIR)$(EMC2_HOME)/bin
 	cp fgfdm_lsnr $(DESTDIR)$(EMC2_HOME)/bin/
+	cp fgfdm_sndr $(DESTDIR)$(EMC2_HOME)/bin/
+	cp fgfdm_bench $(DESTDIR)$(EMC2_HOME)/bin/
+	cp fgfdm_trace $(DESTDIR)$(EMC2_HOME)/bin/
+	cp fgfdm_gen $(DESTDIR)$(EMC2_HOME)/bin/
 
-fgfdm_lsnr: fgfdm_lsnr.o net_fdm.o
-	$(CC) -o $@ fgfdm_lsnr.o net_fdm.o -Wl,-rpath,$(LIBDIR) -L$(LIBDIR) -llinuxcnchal -lrt
+fgfdm_lsnr: fgfdm_lsnr.o fgfdm_generic.o net_fdm.o
+	$(CC) -o $@ fgfdm_lsnr.o fgfdm_generic.o net_fdm.o -Wl,-rpath,$(LIBDIR) -L$(LIBDIR) -llinuxcnchal -lrt
+
+fgfdm_sndr: fgfdm_sndr.o
+	$(CC) -o $@ fgfdm_sndr.o -Wl,-rpath,$(LIBDIR) -L$(LIBDIR) -llinuxcnchal -lrt
+
+fgfdm_bench: fgfdm_bench.o net_fdm.o
+	$(CC) -o $@ fgfdm_bench.o net_fdm.o -Wl,-rpath,$(LIBDIR) -L$(LIBDIR) -llinuxcnchal -lrt
+
+fgfdm_trace: fgfdm_trace.o
+	$(CC) -o $@ fgfdm_trace.o -Wl,-rpath,$(LIBDIR) -L$(LIBDIR) -llinuxcnchal -lrt
+
+fgfdm_gen: fgfdm_gen.o net_fdm.o
+	$(CC) -o $@ fgfdm_gen.o net_fdm.o -lm -lrt
 
 %.o: %.c
 	$(CC) -o $@ $(EXTRA_CFLAGS) -URTAPI -U__MODULE__ -DULAPI -Os -c $<